@@ -0,0 +1,218 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+
+#include "huge_pages.h"
+
+static const size_t Huge_Page_1G = (size_t)1 << 30;
+static const size_t Huge_Page_2M = (size_t)1 << 21;
+
+static const char *const Huge_Page_Names[HUGE_PAGE_NUMBER_OF_KINDS] = { "1g", "2m", "thp", "normal" };
+
+int Huge_Page_Find(const char *name)
+{
+    for (int kind = 0; kind < HUGE_PAGE_NUMBER_OF_KINDS; kind++)
+    {
+        if (strcmp(name, Huge_Page_Names[kind]) == 0)
+        {
+            return kind;
+        }
+    }
+    return -1;
+}
+
+const char *Huge_Page_Name(Huge_Page_Kind kind)
+{
+    return Huge_Page_Names[kind];
+}
+
+static size_t Round_Up(size_t length, size_t page_size)
+{
+    return (length + page_size - 1) / page_size * page_size;
+}
+
+// Maps explicit huge pages of 2^page_shift bytes from their pool
+static void *Map_Hugetlb(size_t length, int page_shift)
+{
+    void *data = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (page_shift << MAP_HUGE_SHIFT), -1, 0);
+    return data == MAP_FAILED ? NULL : data;
+}
+
+// Maps normal pages starting on a 2 MiB boundary, the only place a transparent huge page can go
+static void *Map_Aligned(size_t length)
+{
+    char *data = mmap(NULL, length + Huge_Page_2M, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (data == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    // Gives back the slack before and after the aligned range
+    char *aligned = (char *)Round_Up((uintptr_t)data, Huge_Page_2M);
+    if (aligned > data)
+    {
+        munmap(data, (size_t)(aligned - data));
+    }
+    munmap(aligned + length, (size_t)(data + Huge_Page_2M - aligned));
+    return aligned;
+}
+
+int Huge_Buffer_Alloc(Huge_Buffer *buffer, size_t length, Huge_Page_Kind largest)
+{
+    buffer->data = NULL;
+    buffer->length = length;
+
+    if (largest <= HUGE_PAGE_1G)
+    {
+        buffer->mappedLength = Round_Up(length, Huge_Page_1G);
+        buffer->data = Map_Hugetlb(buffer->mappedLength, 30);
+        buffer->kind = HUGE_PAGE_1G;
+    }
+    if (buffer->data == NULL && largest <= HUGE_PAGE_2M)
+    {
+        buffer->mappedLength = Round_Up(length, Huge_Page_2M);
+        buffer->data = Map_Hugetlb(buffer->mappedLength, 21);
+        buffer->kind = HUGE_PAGE_2M;
+    }
+    if (buffer->data == NULL && largest <= HUGE_PAGE_TRANSPARENT)
+    {
+        buffer->mappedLength = Round_Up(length, Huge_Page_2M);
+        buffer->data = Map_Aligned(buffer->mappedLength);
+        buffer->kind = HUGE_PAGE_TRANSPARENT;
+        // Without transparent huge page support these simply stay normal pages
+        if (buffer->data != NULL && madvise(buffer->data, buffer->mappedLength, MADV_HUGEPAGE) != 0)
+        {
+            buffer->kind = HUGE_PAGE_NORMAL;
+        }
+    }
+    if (buffer->data == NULL)
+    {
+        buffer->mappedLength = length;
+        buffer->data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        buffer->kind = HUGE_PAGE_NORMAL;
+        if (buffer->data == MAP_FAILED)
+        {
+            buffer->data = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+double Huge_Buffer_Huge_Fraction(const Huge_Buffer *buffer)
+{
+    if (buffer->kind == HUGE_PAGE_1G || buffer->kind == HUGE_PAGE_2M)
+    {
+        return 1;
+    }
+    if (buffer->kind == HUGE_PAGE_NORMAL || buffer->mappedLength == 0)
+    {
+        return 0;
+    }
+
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+    if (smaps == NULL)
+    {
+        return 0;
+    }
+
+    // Adds up the AnonHugePages of the mappings that overlap the buffer. The kernel may merge the
+    // buffer with a neighbouring mapping that has the same flags, such as another buffer; smaps
+    // then can't tell whose huge pages are whose, so such a mapping counts for at most its overlap
+    // with the buffer and the result is an upper bound
+    uintptr_t begin = (uintptr_t)buffer->data, end = begin + buffer->mappedLength;
+    size_t overlap = 0;
+    size_t hugeBytes = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), smaps) != NULL)
+    {
+        uintptr_t mappingBegin, mappingEnd;
+        size_t kilobytes;
+        if (sscanf(line, "%lx-%lx ", &mappingBegin, &mappingEnd) == 2)
+        {
+            uintptr_t overlapBegin = mappingBegin > begin ? mappingBegin : begin;
+            uintptr_t overlapEnd = mappingEnd < end ? mappingEnd : end;
+            overlap = overlapBegin < overlapEnd ? overlapEnd - overlapBegin : 0;
+        }
+        else if (overlap > 0 && sscanf(line, "AnonHugePages: %zu kB", &kilobytes) == 1)
+        {
+            hugeBytes += kilobytes * 1024 < overlap ? kilobytes * 1024 : overlap;
+        }
+    }
+    fclose(smaps);
+
+    return (double)hugeBytes / buffer->mappedLength;
+}
+
+void Huge_Buffer_Free(Huge_Buffer *buffer)
+{
+    if (buffer->data != NULL)
+    {
+        munmap(buffer->data, buffer->mappedLength);
+        buffer->data = NULL;
+    }
+}
+
+int Tlb_Counter_Open(Tlb_Counter *counter)
+{
+    struct perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HW_CACHE;
+    attributes.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attributes.disabled = 1;
+    // Counts the threads started from now on too
+    attributes.inherit = 1;
+    // The page walks of user space loads happen in user mode, and leaving out the kernel is
+    // what the default perf_event_paranoid setting still allows
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+
+    counter->fd = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+    return counter->fd < 0 ? -1 : 0;
+}
+
+void Tlb_Counter_Start(const Tlb_Counter *counter)
+{
+    if (counter->fd >= 0)
+    {
+        ioctl(counter->fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter->fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+long long Tlb_Counter_Stop(const Tlb_Counter *counter)
+{
+    if (counter->fd < 0)
+    {
+        return -1;
+    }
+
+    ioctl(counter->fd, PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t count;
+    if (read(counter->fd, &count, sizeof(count)) != sizeof(count))
+    {
+        return -1;
+    }
+    return (long long)count;
+}
+
+void Tlb_Counter_Close(Tlb_Counter *counter)
+{
+    if (counter->fd >= 0)
+    {
+        close(counter->fd);
+        counter->fd = -1;
+    }
+}
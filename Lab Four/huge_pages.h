@@ -0,0 +1,83 @@
+#ifndef LAB4_HUGE_PAGES_H
+#define LAB4_HUGE_PAGES_H
+
+#include <stddef.h>
+
+/*
+ * Buffers on the largest pages the system will hand out, and a counter of
+ * the data TLB misses they are meant to save.
+ *
+ * Sorting gigabytes on 4 KiB pages needs far more TLB entries than any CPU
+ * has, so most pages the partitioning moves to cost a page walk. Huge_Buffer_Alloc tries,
+ * from the largest kind it is allowed down to normal pages:
+ *
+ *   1g      explicit 1 GiB pages (MAP_HUGETLB), needs a reserved pool
+ *           (hugepages-1048576kB/nr_hugepages or hugepagesz=1G on boot)
+ *   2m      explicit 2 MiB pages, from the hugepages-2048kB pool
+ *   thp     normal pages 2 MiB aligned with MADV_HUGEPAGE, the kernel backs
+ *           them with transparent huge pages when it can find them
+ *   normal  4 KiB pages
+ *
+ * Explicit huge pages are reserved when the buffer is mapped, so a pool
+ * that is too small makes the mapping fail and the next kind is tried.
+ * Transparent huge pages are only given out when the memory is touched,
+ * Huge_Buffer_Huge_Fraction tells how much of it got them afterwards.
+ */
+
+typedef enum Huge_Page_Kind {
+    HUGE_PAGE_1G,
+    HUGE_PAGE_2M,
+    HUGE_PAGE_TRANSPARENT,
+    HUGE_PAGE_NORMAL,
+    HUGE_PAGE_NUMBER_OF_KINDS
+} Huge_Page_Kind;
+
+typedef struct Huge_Buffer {
+    void *data;
+    // Bytes asked for, and bytes mapped after rounding up to whole pages
+    size_t length;
+    size_t mappedLength;
+    Huge_Page_Kind kind;
+} Huge_Buffer;
+
+// Returns the kind with the given name, or -1 if there is no such kind
+int Huge_Page_Find(const char *name);
+
+const char *Huge_Page_Name(Huge_Page_Kind kind);
+
+// Maps length zeroed bytes on the largest kind of page, not larger than
+// largest, that can be had. Returns 0 on success and -1 with errno set if
+// not even normal pages could be mapped
+int Huge_Buffer_Alloc(Huge_Buffer *buffer, size_t length, Huge_Page_Kind largest);
+
+// Fraction of the buffer that is backed by huge pages, 1 for explicit huge
+// pages and what /proc/self/smaps reports for the others. Where the kernel
+// merged the buffer with a neighbouring mapping this is an upper bound
+double Huge_Buffer_Huge_Fraction(const Huge_Buffer *buffer);
+
+void Huge_Buffer_Free(Huge_Buffer *buffer);
+
+/*
+ * Data TLB read misses of this process and of the threads it starts after
+ * the counter is opened, counted with perf_event_open. Open the counter
+ * before the first OpenMP parallel region so the team is counted as well.
+ * Where the CPU has no such event, or perf_event_paranoid forbids it, the
+ * counter stays closed and reads as -1.
+ */
+
+typedef struct Tlb_Counter {
+    int fd;
+} Tlb_Counter;
+
+// Returns 0 on success and -1 with errno set if the counter is unavailable
+int Tlb_Counter_Open(Tlb_Counter *counter);
+
+// Resets the count to zero and starts counting
+void Tlb_Counter_Start(const Tlb_Counter *counter);
+
+// Stops counting and returns the misses since Tlb_Counter_Start, -1 when unavailable
+long long Tlb_Counter_Stop(const Tlb_Counter *counter);
+
+void Tlb_Counter_Close(Tlb_Counter *counter);
+
+#endif //LAB4_HUGE_PAGES_H
@@ -6,11 +6,16 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
+#include <getopt.h>
+#include <string.h>
 #include <omp.h>
 #include <time.h>
 #include <sys/time.h>
 #include <memory.h>
 
+#include "huge_pages.h"
+
 // Number of values to sort
 static const long Num_To_Sort = 1000000000;
 
@@ -160,8 +165,71 @@ void sort_p(int* arr)
     }
 }
 
-int main() {
-    int* arr_s = malloc(sizeof(int) * Num_To_Sort);
+static void Print_Tlb_Misses(long long misses)
+{
+    if (misses >= 0)
+    {
+        printf("%lld dTLB misses\n", misses);
+    }
+    else
+    {
+        printf("dTLB misses not counted\n");
+    }
+}
+
+static void Print_Usage(const char *program)
+{
+    printf("Usage: %s [options]\n"
+           "  --pages KIND  largest pages to put the arrays on: 1g (default), 2m, thp or normal;\n"
+           "                smaller ones are tried when those can't be had\n",
+           program);
+}
+
+int main(int argc, char *argv[]) {
+    int pages = HUGE_PAGE_1G;
+
+    static const struct option Long_Options[] = {
+        { "pages", required_argument, NULL, 'P' },
+        { "help",  no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "h", Long_Options, NULL)) != -1)
+    {
+        switch (option)
+        {
+            case 'P':
+                pages = Huge_Page_Find(optarg);
+                if (pages < 0)
+                {
+                    fprintf(stderr, "Unknown page kind \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'h':
+                Print_Usage(argv[0]);
+                return 0;
+            default:
+                Print_Usage(argv[0]);
+                return 1;
+        }
+    }
+
+    // Opened before the OpenMP team exists so its threads are counted too
+    Tlb_Counter tlbCounter;
+    if (Tlb_Counter_Open(&tlbCounter) != 0)
+    {
+        fprintf(stderr, "dTLB misses can't be counted: %s\n", strerror(errno));
+    }
+
+    Huge_Buffer buffer_s, buffer_p;
+    if (Huge_Buffer_Alloc(&buffer_s, sizeof(int) * Num_To_Sort, (Huge_Page_Kind)pages) != 0)
+    {
+        fprintf(stderr, "Could not allocate %ld numbers\n", Num_To_Sort);
+        return 1;
+    }
+    int* arr_s = buffer_s.data;
     const long chunk_size = Num_To_Sort / omp_get_max_threads();
 #pragma omp parallel num_threads(omp_get_max_threads())
     {
@@ -177,26 +245,46 @@ int main() {
     // Copy the array so that the sorting function can operate on it directly.
     // Note that this doubles the memory usage.
     // You may wish to test with slightly smaller arrays if you're running out of memory.
-    int* arr_p = malloc(sizeof(int) * Num_To_Sort);
+    if (Huge_Buffer_Alloc(&buffer_p, sizeof(int) * Num_To_Sort, (Huge_Page_Kind)pages) != 0)
+    {
+        fprintf(stderr, "Could not allocate %ld numbers\n", Num_To_Sort);
+        Huge_Buffer_Free(&buffer_s);
+        return 1;
+    }
+    int* arr_p = buffer_p.data;
     memcpy(arr_p, arr_s, sizeof(int) * Num_To_Sort);
 
+    printf("Sequential array on %s pages, %.1f%% of them huge\n", Huge_Page_Name(buffer_s.kind),
+           100 * Huge_Buffer_Huge_Fraction(&buffer_s));
+    printf("Parallel array on %s pages, %.1f%% of them huge\n\n", Huge_Page_Name(buffer_p.kind),
+           100 * Huge_Buffer_Huge_Fraction(&buffer_p));
+
     struct timeval start, end;
 
     printf("Timing sequential...\n");
+    Tlb_Counter_Start(&tlbCounter);
     gettimeofday(&start, NULL);
     sort_s(arr_s);
     gettimeofday(&end, NULL);
-    printf("Took %f seconds\n\n", end.tv_sec - start.tv_sec + (double)(end.tv_usec - start.tv_usec) / 1000000);
+    long long tlbMisses = Tlb_Counter_Stop(&tlbCounter);
+    printf("Took %f seconds, ", end.tv_sec - start.tv_sec + (double)(end.tv_usec - start.tv_usec) / 1000000);
+    Print_Tlb_Misses(tlbMisses);
+    printf("\n");
 
-    free(arr_s);
+    Huge_Buffer_Free(&buffer_s);
 
     printf("Timing parallel...\n");
+    Tlb_Counter_Start(&tlbCounter);
     gettimeofday(&start, NULL);
     sort_p(arr_p);
     gettimeofday(&end, NULL);
-    printf("Took %f seconds\n\n", end.tv_sec - start.tv_sec + (double)(end.tv_usec - start.tv_usec) / 1000000);
+    tlbMisses = Tlb_Counter_Stop(&tlbCounter);
+    printf("Took %f seconds, ", end.tv_sec - start.tv_sec + (double)(end.tv_usec - start.tv_usec) / 1000000);
+    Print_Tlb_Misses(tlbMisses);
+    printf("\n");
 
-    free(arr_p);
+    Huge_Buffer_Free(&buffer_p);
+    Tlb_Counter_Close(&tlbCounter);
 
     return 0;
 }
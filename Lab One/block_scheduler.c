@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <omp.h>
+
+#include "block_scheduler.h"
+#include "placement.h"
+
+// The blocks [begin, end) a thread still has to run, begin in the low 32
+// bits and end in the high 32 bits of range. Padded to a cache line so
+// threads taking blocks don't invalidate each other's queues
+typedef struct Block_Queue {
+	_Alignas(64) _Atomic uint64_t range;
+} Block_Queue;
+
+// Everything one thread writes while running blocks, on its own pages so it
+// sits on the thread's node and shares no cache line with other threads
+typedef struct Thread_State {
+	Block_Queue queue;
+	Scheduler_Thread_Stats stats;
+} Thread_State;
+
+static inline uint64_t Pack_Range(uint32_t begin, uint32_t end)
+{
+	return (uint64_t)end << 32 | begin;
+}
+
+// Takes the first block of the thread's own queue
+static int Take_Block(Block_Queue *queue, uint32_t *block)
+{
+	uint64_t range = atomic_load_explicit(&queue->range, memory_order_relaxed);
+	for (;;)
+	{
+		uint32_t begin = (uint32_t)range, end = (uint32_t)(range >> 32);
+		if (begin >= end)
+		{
+			return 0;
+		}
+		if (atomic_compare_exchange_weak(&queue->range, &range, Pack_Range(begin + 1, end)))
+		{
+			*block = begin;
+			return 1;
+		}
+	}
+}
+
+// Moves the back half of some other thread's queue into the empty queue of thread
+static uint32_t Steal_Blocks(Thread_State **states, int number_of_threads, int thread)
+{
+	for (int offset = 1; offset < number_of_threads; offset++)
+	{
+		Block_Queue *victim = &states[(thread + offset) % number_of_threads]->queue;
+		uint64_t range = atomic_load_explicit(&victim->range, memory_order_relaxed);
+		for (;;)
+		{
+			uint32_t begin = (uint32_t)range, end = (uint32_t)(range >> 32);
+			if (begin >= end)
+			{
+				break;
+			}
+
+			uint32_t stolen = (end - begin + 1) / 2;
+			if (atomic_compare_exchange_weak(&victim->range, &range, Pack_Range(begin, end - stolen)))
+			{
+				atomic_store(&states[thread]->queue.range, Pack_Range(end - stolen, end));
+				return stolen;
+			}
+		}
+	}
+	return 0;
+}
+
+void Scheduler_Run_Blocks(uint64_t number_of_blocks, Block_Fn run_block, void *context, Scheduler_Stats *stats)
+{
+	if (number_of_blocks > SCHEDULER_MAX_BLOCKS)
+	{
+		fprintf(stderr, "Too many scheduler blocks (%llu)\n", (unsigned long long)number_of_blocks);
+		abort();
+	}
+
+	int numberOfThreads = omp_get_max_threads();
+	Thread_State **states = calloc((size_t)numberOfThreads, sizeof(Thread_State *));
+	Scheduler_Thread_Stats *threadStats = calloc((size_t)numberOfThreads, sizeof(Scheduler_Thread_Stats));
+
+	double start = omp_get_wtime();
+
+	#pragma omp parallel num_threads(numberOfThreads)
+	{
+		int thread = omp_get_thread_num();
+		Placement_Pin_Thread(thread);
+
+		// Every thread starts with an equal contiguous share of the blocks
+		Thread_State *mine = Placement_Alloc_Local(sizeof(Thread_State));
+		if (mine == NULL)
+		{
+			fprintf(stderr, "Could not allocate the state of scheduler thread %d\n", thread);
+			abort();
+		}
+		uint32_t begin = (uint32_t)(number_of_blocks * thread / numberOfThreads);
+		uint32_t end = (uint32_t)(number_of_blocks * (thread + 1) / numberOfThreads);
+		atomic_init(&mine->queue.range, Pack_Range(begin, end));
+		states[thread] = mine;
+
+		// Nobody steals before every queue is published
+		#pragma omp barrier
+
+		for (;;)
+		{
+			uint32_t block;
+			if (!Take_Block(&mine->queue, &block))
+			{
+				uint32_t stolen = Steal_Blocks(states, numberOfThreads, thread);
+				if (stolen == 0)
+				{
+					// Every queue was empty, whatever is still running belongs to its thread
+					break;
+				}
+				mine->stats.blocksStolen += stolen;
+				mine->stats.steals++;
+				continue;
+			}
+
+			double blockStart = omp_get_wtime();
+			run_block(block, context);
+			mine->stats.busySeconds += omp_get_wtime() - blockStart;
+			mine->stats.blocksCompleted++;
+		}
+	}
+
+	double seconds = omp_get_wtime() - start;
+	for (int i = 0; i < numberOfThreads; i++)
+	{
+		threadStats[i] = states[i]->stats;
+		Placement_Free_Local(states[i], sizeof(Thread_State));
+	}
+	free(states);
+
+	if (stats != NULL)
+	{
+		stats->numberOfThreads = numberOfThreads;
+		stats->threads = threadStats;
+		stats->seconds = seconds;
+	}
+	else
+	{
+		free(threadStats);
+	}
+}
+
+void Scheduler_Print_Stats(const Scheduler_Stats *stats)
+{
+	printf("%-8s %10s %10s %8s %10s %8s\n", "thread", "blocks", "stolen", "steals", "busy (s)", "busy %");
+	for (int i = 0; i < stats->numberOfThreads; i++)
+	{
+		const Scheduler_Thread_Stats *thread = &stats->threads[i];
+		printf("%-8d %10llu %10llu %8llu %10.4f %7.1f%%\n", i, (unsigned long long)thread->blocksCompleted,
+			   (unsigned long long)thread->blocksStolen, (unsigned long long)thread->steals, thread->busySeconds,
+			   stats->seconds > 0 ? 100 * thread->busySeconds / stats->seconds : 0);
+	}
+}
+
+void Scheduler_Stats_Free(Scheduler_Stats *stats)
+{
+	free(stats->threads);
+	stats->threads = NULL;
+	stats->numberOfThreads = 0;
+}
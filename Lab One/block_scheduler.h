@@ -0,0 +1,71 @@
+#ifndef LAB1_BLOCK_SCHEDULER_H
+#define LAB1_BLOCK_SCHEDULER_H
+
+#include <stdint.h>
+
+/*
+ * Splits a run into fixed logical blocks of samples that the OpenMP threads
+ * pick up dynamically.
+ *
+ * A block always covers the same samples no matter which thread runs it or
+ * how many threads there are, and because the generators are counter-based
+ * those samples are the same random numbers too. The drivers store one
+ * partial result per block and combine them in block order afterwards, so
+ * even floating point sums come out bit for bit the same on any machine.
+ *
+ * The blocks are served by a work stealing scheduler: every thread starts
+ * with an equal contiguous range of blocks and takes them from the front of
+ * it. A thread that runs out steals the back half of the range of another
+ * thread, so on hybrid P-core/E-core machines, or when a thread gets
+ * preempted, the faster threads simply end up running more blocks. A range
+ * is a single 64 bit word updated with compare and swap, so neither taking
+ * nor stealing blocks ever takes a lock.
+ */
+
+// Samples in every block but the last
+#define SCHEDULER_BLOCK_SIZE (UINT64_C(1) << 20)
+
+// Runs one block, context is passed through from Scheduler_Run_Blocks
+typedef void (*Block_Fn)(uint64_t block, void *context);
+
+// Number of blocks needed to cover number_of_samples
+static inline uint64_t Scheduler_Block_Count(uint64_t number_of_samples)
+{
+	return (number_of_samples + SCHEDULER_BLOCK_SIZE - 1) / SCHEDULER_BLOCK_SIZE;
+}
+
+// First sample and size of block, the last block takes whatever is left
+static inline void Scheduler_Block_Range(uint64_t block, uint64_t number_of_samples, uint64_t *first_sample, uint64_t *samples)
+{
+	*first_sample = block * SCHEDULER_BLOCK_SIZE;
+	*samples = number_of_samples - *first_sample < SCHEDULER_BLOCK_SIZE ? number_of_samples - *first_sample : SCHEDULER_BLOCK_SIZE;
+}
+
+// The block indices of a range are stored in 32 bits, which is 2^52 samples
+#define SCHEDULER_MAX_BLOCKS UINT32_MAX
+
+typedef struct Scheduler_Thread_Stats {
+	uint64_t blocksCompleted;
+	// Blocks this thread took from other threads, and in how many steals
+	uint64_t blocksStolen;
+	uint64_t steals;
+	double busySeconds;
+} Scheduler_Thread_Stats;
+
+typedef struct Scheduler_Stats {
+	int numberOfThreads;
+	Scheduler_Thread_Stats *threads;
+	double seconds;
+} Scheduler_Stats;
+
+// Calls run_block for every block in [0, number_of_blocks) on the OpenMP
+// threads. If stats is not NULL it receives what every thread did and must
+// be released with Scheduler_Stats_Free
+void Scheduler_Run_Blocks(uint64_t number_of_blocks, Block_Fn run_block, void *context, Scheduler_Stats *stats);
+
+// Writes one line per thread with its completed and stolen blocks
+void Scheduler_Print_Stats(const Scheduler_Stats *stats);
+
+void Scheduler_Stats_Free(Scheduler_Stats *stats);
+
+#endif //LAB1_BLOCK_SCHEDULER_H
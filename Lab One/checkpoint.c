@@ -0,0 +1,94 @@
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+
+static const char Checkpoint_Magic[8] = { 'L', '1', 'P', 'I', 'C', 'K', 'P', '1' };
+
+// On disk layout, all integers in host byte order
+typedef struct Checkpoint_File {
+	char magic[8];
+	Pi_Checkpoint checkpoint;
+	uint64_t checksum;
+} Checkpoint_File;
+
+// FNV-1a over the magic and the checkpoint, catches truncated or corrupted files
+static uint64_t Checkpoint_Checksum(const Checkpoint_File *file)
+{
+	const unsigned char *bytes = (const unsigned char *)file;
+	uint64_t hash = UINT64_C(0xCBF29CE484222325);
+	for (size_t i = 0; i < offsetof(Checkpoint_File, checksum); i++)
+	{
+		hash ^= bytes[i];
+		hash *= UINT64_C(0x100000001B3);
+	}
+	return hash;
+}
+
+int Checkpoint_Write(const char *path, const Pi_Checkpoint *checkpoint)
+{
+	Checkpoint_File file;
+	memset(&file, 0, sizeof(file));
+	memcpy(file.magic, Checkpoint_Magic, sizeof(file.magic));
+	file.checkpoint = *checkpoint;
+	file.checksum = Checkpoint_Checksum(&file);
+
+	char temporaryPath[4096];
+	if (snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", path) >= (int)sizeof(temporaryPath))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	FILE *output = fopen(temporaryPath, "wb");
+	if (output == NULL)
+	{
+		return -1;
+	}
+
+	// The data has to be on disk before the rename makes it the checkpoint
+	if (fwrite(&file, sizeof(file), 1, output) != 1 || fflush(output) != 0 || fsync(fileno(output)) != 0)
+	{
+		int error = errno;
+		fclose(output);
+		remove(temporaryPath);
+		errno = error;
+		return -1;
+	}
+
+	if (fclose(output) != 0 || rename(temporaryPath, path) != 0)
+	{
+		int error = errno;
+		remove(temporaryPath);
+		errno = error;
+		return -1;
+	}
+
+	return 0;
+}
+
+int Checkpoint_Read(const char *path, Pi_Checkpoint *checkpoint)
+{
+	FILE *input = fopen(path, "rb");
+	if (input == NULL)
+	{
+		return errno == ENOENT ? 1 : -1;
+	}
+
+	Checkpoint_File file;
+	size_t read = fread(&file, sizeof(file), 1, input);
+	fclose(input);
+
+	if (read != 1 || memcmp(file.magic, Checkpoint_Magic, sizeof(file.magic)) != 0 ||
+	    file.checksum != Checkpoint_Checksum(&file))
+	{
+		return -1;
+	}
+
+	*checkpoint = file.checkpoint;
+	checkpoint->kernel[CHECKPOINT_KERNEL_NAME_LENGTH - 1] = '\0';
+	return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef LAB1_CHECKPOINT_H
+#define LAB1_CHECKPOINT_H
+
+#include <stdint.h>
+
+/*
+ * Checkpoint of a long running pi estimate.
+ *
+ * With the counter-based generator the position of every stream is just a
+ * toss index, and the long run only checkpoints once every toss below
+ * completedTosses has been counted, so the whole state of the run fits in a
+ * few words. The file is written to a temporary name and renamed over the
+ * old one, so a run killed while writing leaves the previous checkpoint.
+ */
+
+#define CHECKPOINT_KERNEL_NAME_LENGTH 16
+
+typedef struct Pi_Checkpoint {
+	uint64_t seed;
+	uint64_t totalTosses;
+	// Tosses [0, completedTosses) are counted, the run resumes from here
+	uint64_t completedTosses;
+	uint64_t samplesInCircle;
+	// The integer kernels may count a boundary toss differently, so a run is
+	// only resumed with the kernel it started with
+	char kernel[CHECKPOINT_KERNEL_NAME_LENGTH];
+} Pi_Checkpoint;
+
+// Atomically replaces the checkpoint at path. Returns 0 on success, -1 with errno set otherwise
+int Checkpoint_Write(const char *path, const Pi_Checkpoint *checkpoint);
+
+// Reads the checkpoint at path. Returns 0 on success, 1 if there is no
+// checkpoint and -1 if the file can't be read or is not a valid checkpoint
+int Checkpoint_Read(const char *path, Pi_Checkpoint *checkpoint);
+
+#endif //LAB1_CHECKPOINT_H
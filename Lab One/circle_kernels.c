@@ -0,0 +1,555 @@
+#include <stdio.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "circle_kernels.h"
+#include "rng.h"
+#include "philox_simd.h"
+#include "toss_generators.h"
+
+/*
+ * The vector kernels run the Philox rounds for 8 (AVX2) or 16 (AVX-512)
+ * counter blocks side by side, one block per 32 bit lane. Each block holds
+ * two tosses, so one iteration tests 16 or 32 points. The circle test is done
+ * with mask compares that are subtracted from 64 bit lane counters, so there
+ * are no branches in the inner loop.
+ *
+ * The vector kernels compare x^2 + y^2 < 2^62 on the raw signed 32 bit words,
+ * which is the scalar (x / 2^31)^2 + (y / 2^31)^2 < 1 test scaled by a power
+ * of two, so the rounding and therefore every decision is identical. This
+ * file is compiled with -ffp-contract=off so the compiler can't fuse the
+ * multiply and add of one path but not the other.
+ *
+ * The "-int" kernels skip floating point altogether: the squares of the
+ * signed words are formed exactly in 64 bit integers and compared against
+ * 2^62. Each square is at most 2^62 but the sum reaches 2^63 at
+ * x = y = -2^31, so the sum and the compare are unsigned. Because the sum is
+ * exact these kernels may disagree with the double kernels on the handful of
+ * points whose rounded double radius lands on the boundary, roughly one toss
+ * in 2^30, which is far below the statistical error of any run.
+ *
+ * The "buffered" kernel splits generation from testing: the active toss
+ * generator fills an L1 sized buffer and a separate loop, cloned for each
+ * instruction set and left to the compiler to vectorise, tests the buffer.
+ */
+
+// Random words used by one toss, its x and y
+static const uint64_t Words_Per_Toss = 2;
+
+// Tosses held by one Philox block of 4 words
+static const uint64_t Tosses_Per_Block = 2;
+
+// Returns a random value between -1 and 1
+double getRand(Rng_Stream *stream)
+{
+	return (int32_t)Rng_Next_U32(stream) * 0x1p-31;
+}
+
+static uint64_t Count_In_Circle_Scalar(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed)
+{
+	double x, y;
+	uint64_t numberOfSamplesInCircle = 0;
+
+	Rng_Stream stream;
+	Rng_Stream_Init(&stream, seed, 0);
+	Rng_Stream_Seek(&stream, first_toss * Words_Per_Toss);
+
+	for (uint64_t i = 0; i < number_of_tosses; i++)
+	{
+		x = getRand(&stream);
+		y = getRand(&stream);
+		if (x * x + y * y < 1) {
+			numberOfSamplesInCircle++;
+		}
+	}
+
+	return numberOfSamplesInCircle;
+}
+
+static uint64_t Count_In_Circle_Scalar_Int(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed)
+{
+	uint64_t numberOfSamplesInCircle = 0;
+
+	Rng_Stream stream;
+	Rng_Stream_Init(&stream, seed, 0);
+	Rng_Stream_Seek(&stream, first_toss * Words_Per_Toss);
+
+	for (uint64_t i = 0; i < number_of_tosses; i++)
+	{
+		int64_t x = (int32_t)Rng_Next_U32(&stream);
+		int64_t y = (int32_t)Rng_Next_U32(&stream);
+		numberOfSamplesInCircle += (uint64_t)(x * x) + (uint64_t)(y * y) < (UINT64_C(1) << 62);
+	}
+
+	return numberOfSamplesInCircle;
+}
+
+static int Always_Supported(void)
+{
+	return 1;
+}
+
+/* ---------------------------------------------------------------- AVX2 --- */
+
+static int Avx2_Supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+// Adds one to the 64 bit lanes of hits where the 4 points (x, y) are in the circle
+TARGET_AVX2
+static inline __m256i Accumulate_Hits_Avx2(__m256i hits, __m128i x, __m128i y)
+{
+	__m256d xd = _mm256_cvtepi32_pd(x);
+	__m256d yd = _mm256_cvtepi32_pd(y);
+	__m256d radius = _mm256_add_pd(_mm256_mul_pd(xd, xd), _mm256_mul_pd(yd, yd));
+	__m256d inside = _mm256_cmp_pd(radius, _mm256_set1_pd(0x1p62), _CMP_LT_OQ);
+
+	// A true compare is all ones, which is -1 as a 64 bit integer
+	return _mm256_sub_epi64(hits, _mm256_castpd_si256(inside));
+}
+
+// Same as Accumulate_Hits_Avx2 for 8 points, with the exact integer test
+TARGET_AVX2
+static inline __m256i Accumulate_Hits_Int_Avx2(__m256i hits, __m256i x, __m256i y)
+{
+	const __m256i zero = _mm256_setzero_si256();
+
+	// _mm256_mul_epi32 squares the even lanes into 64 bits, the odd lanes are shifted down first
+	__m256i xOdd = _mm256_srli_epi64(x, 32);
+	__m256i yOdd = _mm256_srli_epi64(y, 32);
+	__m256i radiusEven = _mm256_add_epi64(_mm256_mul_epi32(x, x), _mm256_mul_epi32(y, y));
+	__m256i radiusOdd = _mm256_add_epi64(_mm256_mul_epi32(xOdd, xOdd), _mm256_mul_epi32(yOdd, yOdd));
+
+	// AVX2 has no unsigned compare, below 2^62 means the top two bits are clear
+	hits = _mm256_sub_epi64(hits, _mm256_cmpeq_epi64(_mm256_srli_epi64(radiusEven, 62), zero));
+	return _mm256_sub_epi64(hits, _mm256_cmpeq_epi64(_mm256_srli_epi64(radiusOdd, 62), zero));
+}
+
+// Shared body of the AVX2 kernels, specialised on the circle test at compile time
+TARGET_AVX2
+static inline __attribute__((always_inline))
+uint64_t Count_In_Circle_Avx2_Loop(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed, const int integer_test)
+{
+	const uint64_t Blocks_Per_Step = 8;
+
+	uint64_t toss = first_toss;
+	uint64_t endToss = first_toss + number_of_tosses;
+	uint64_t numberOfSamplesInCircle = 0;
+
+	Circle_Count_Fn countScalar = integer_test ? Count_In_Circle_Scalar_Int : Count_In_Circle_Scalar;
+
+	// A slice starting on the second toss of a block is aligned with one scalar toss
+	if (toss % Tosses_Per_Block != 0 && toss < endToss)
+	{
+		numberOfSamplesInCircle += countScalar(toss, 1, seed);
+		toss++;
+	}
+
+	Philox_Key key = Philox_Make_Key(seed);
+	uint64_t block = toss / Tosses_Per_Block;
+	uint64_t steps = (endToss - toss) / (Tosses_Per_Block * Blocks_Per_Step);
+
+	__m256i hits = _mm256_setzero_si256();
+
+	for (uint64_t step = 0; step < steps; step++, block += Blocks_Per_Step)
+	{
+		__m256i c[4];
+		Philox_Counters_Avx2(c, block, 0);
+		Philox4x32_Avx2(c, key);
+
+		// Words 0/1 are the first toss of each block and words 2/3 the second
+		if (integer_test)
+		{
+			hits = Accumulate_Hits_Int_Avx2(hits, c[0], c[1]);
+			hits = Accumulate_Hits_Int_Avx2(hits, c[2], c[3]);
+		}
+		else
+		{
+			hits = Accumulate_Hits_Avx2(hits, _mm256_castsi256_si128(c[0]), _mm256_castsi256_si128(c[1]));
+			hits = Accumulate_Hits_Avx2(hits, _mm256_extracti128_si256(c[0], 1), _mm256_extracti128_si256(c[1], 1));
+			hits = Accumulate_Hits_Avx2(hits, _mm256_castsi256_si128(c[2]), _mm256_castsi256_si128(c[3]));
+			hits = Accumulate_Hits_Avx2(hits, _mm256_extracti128_si256(c[2], 1), _mm256_extracti128_si256(c[3], 1));
+		}
+	}
+
+	uint64_t laneHits[4];
+	_mm256_storeu_si256((__m256i *)laneHits, hits);
+	numberOfSamplesInCircle += laneHits[0] + laneHits[1] + laneHits[2] + laneHits[3];
+
+	toss += steps * Tosses_Per_Block * Blocks_Per_Step;
+	numberOfSamplesInCircle += countScalar(toss, endToss - toss, seed);
+
+	return numberOfSamplesInCircle;
+}
+
+TARGET_AVX2
+static uint64_t Count_In_Circle_Avx2(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed)
+{
+	return Count_In_Circle_Avx2_Loop(first_toss, number_of_tosses, seed, 0);
+}
+
+TARGET_AVX2
+static uint64_t Count_In_Circle_Avx2_Int(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed)
+{
+	return Count_In_Circle_Avx2_Loop(first_toss, number_of_tosses, seed, 1);
+}
+
+/* ------------------------------------------------------------- AVX-512 --- */
+
+static int Avx512_Supported(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+
+// Adds one to the 64 bit lanes of hits where the 8 points (x, y) are in the circle
+TARGET_AVX512
+static inline __m512i Accumulate_Hits_Avx512(__m512i hits, __m256i x, __m256i y)
+{
+	__m512d xd = _mm512_cvtepi32_pd(x);
+	__m512d yd = _mm512_cvtepi32_pd(y);
+	__m512d radius = _mm512_add_pd(_mm512_mul_pd(xd, xd), _mm512_mul_pd(yd, yd));
+	__mmask8 inside = _mm512_cmp_pd_mask(radius, _mm512_set1_pd(0x1p62), _CMP_LT_OQ);
+
+	return _mm512_mask_add_epi64(hits, inside, hits, _mm512_set1_epi64(1));
+}
+
+// Same as Accumulate_Hits_Avx512 for 16 points, with the exact integer test
+TARGET_AVX512
+static inline __m512i Accumulate_Hits_Int_Avx512(__m512i hits, __m512i x, __m512i y)
+{
+	const __m512i limit = _mm512_set1_epi64(INT64_C(1) << 62);
+	const __m512i one = _mm512_set1_epi64(1);
+
+	__m512i xOdd = _mm512_srli_epi64(x, 32);
+	__m512i yOdd = _mm512_srli_epi64(y, 32);
+	__m512i radiusEven = _mm512_add_epi64(_mm512_mul_epi32(x, x), _mm512_mul_epi32(y, y));
+	__m512i radiusOdd = _mm512_add_epi64(_mm512_mul_epi32(xOdd, xOdd), _mm512_mul_epi32(yOdd, yOdd));
+
+	hits = _mm512_mask_add_epi64(hits, _mm512_cmplt_epu64_mask(radiusEven, limit), hits, one);
+	return _mm512_mask_add_epi64(hits, _mm512_cmplt_epu64_mask(radiusOdd, limit), hits, one);
+}
+
+// Shared body of the AVX-512 kernels, specialised on the circle test at compile time
+TARGET_AVX512
+static inline __attribute__((always_inline))
+uint64_t Count_In_Circle_Avx512_Loop(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed, const int integer_test)
+{
+	const uint64_t Blocks_Per_Step = 16;
+
+	uint64_t toss = first_toss;
+	uint64_t endToss = first_toss + number_of_tosses;
+	uint64_t numberOfSamplesInCircle = 0;
+
+	Circle_Count_Fn countScalar = integer_test ? Count_In_Circle_Scalar_Int : Count_In_Circle_Scalar;
+
+	if (toss % Tosses_Per_Block != 0 && toss < endToss)
+	{
+		numberOfSamplesInCircle += countScalar(toss, 1, seed);
+		toss++;
+	}
+
+	Philox_Key key = Philox_Make_Key(seed);
+	uint64_t block = toss / Tosses_Per_Block;
+	uint64_t steps = (endToss - toss) / (Tosses_Per_Block * Blocks_Per_Step);
+
+	__m512i hits = _mm512_setzero_si512();
+
+	for (uint64_t step = 0; step < steps; step++, block += Blocks_Per_Step)
+	{
+		__m512i c[4];
+		Philox_Counters_Avx512(c, block, 0);
+		Philox4x32_Avx512(c, key);
+
+		if (integer_test)
+		{
+			hits = Accumulate_Hits_Int_Avx512(hits, c[0], c[1]);
+			hits = Accumulate_Hits_Int_Avx512(hits, c[2], c[3]);
+		}
+		else
+		{
+			hits = Accumulate_Hits_Avx512(hits, _mm512_castsi512_si256(c[0]), _mm512_castsi512_si256(c[1]));
+			hits = Accumulate_Hits_Avx512(hits, _mm512_extracti64x4_epi64(c[0], 1), _mm512_extracti64x4_epi64(c[1], 1));
+			hits = Accumulate_Hits_Avx512(hits, _mm512_castsi512_si256(c[2]), _mm512_castsi512_si256(c[3]));
+			hits = Accumulate_Hits_Avx512(hits, _mm512_extracti64x4_epi64(c[2], 1), _mm512_extracti64x4_epi64(c[3], 1));
+		}
+	}
+
+	numberOfSamplesInCircle += (uint64_t)_mm512_reduce_add_epi64(hits);
+
+	toss += steps * Tosses_Per_Block * Blocks_Per_Step;
+	numberOfSamplesInCircle += countScalar(toss, endToss - toss, seed);
+
+	return numberOfSamplesInCircle;
+}
+
+TARGET_AVX512
+static uint64_t Count_In_Circle_Avx512(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed)
+{
+	return Count_In_Circle_Avx512_Loop(first_toss, number_of_tosses, seed, 0);
+}
+
+TARGET_AVX512
+static uint64_t Count_In_Circle_Avx512_Int(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed)
+{
+	return Count_In_Circle_Avx512_Loop(first_toss, number_of_tosses, seed, 1);
+}
+
+/* ---------------------------------------------------- Single precision --- */
+
+/*
+ * The "-float" kernels test the circle in single precision, 16 points per
+ * AVX-512 instruction instead of 8. Bias analysis, in units where the circle
+ * is r^2 = 1:
+ *
+ *   - A random word is converted to a float by rounding to 24 significant
+ *     bits, a relative error of at most 2^-24 per coordinate, so at most
+ *     2^-23 on each square.
+ *   - Each square and the sum add one more rounding of at most 2^-24.
+ *
+ * So the float r^2 is within 2^-22 (relative) of the exact one and a float
+ * decision can only differ from the exact one for points with
+ * |r^2 - 1| < 2^-22. That annulus has area 2 pi 2^-22 out of the 4 of the
+ * square, so at most pi 2^-23 (about 3.7e-7) of the tosses can be misjudged,
+ * moving the estimate of pi by at most 1.5e-6. The rounding is to nearest,
+ * so points are pushed in and out of the circle about equally and the
+ * measured bias is far below that bound, but in the worst case it matches
+ * the statistical error (1.64 / sqrt(N) at 90%) around N = 10^12 tosses.
+ * Below that the float kernels are as good as the double ones.
+ *
+ * The hits are counted exactly either way: each lane adds its compare mask
+ * to a 32 bit integer counter that is flushed into a 64 bit total before it
+ * could overflow, so nothing is ever accumulated in floating point.
+ *
+ * The "-mixed" kernel removes the bias altogether. Points whose float r^2
+ * lies within 2^-20 of the boundary, a margin 4 times the worst case error
+ * above, are rare (about one lane in a million) and are retested in double
+ * with the test the double kernels use. Outside the margin the float
+ * decision is the exact one, and so is the double one, so the mixed kernel
+ * returns exactly the count of the double kernels at the speed of the float
+ * ones.
+ */
+
+// Relative distance from the boundary inside which the mixed kernels retest in double
+static const float Mixed_Margin = 0x1p-20f;
+
+static uint64_t Count_In_Circle_Scalar_Float(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed)
+{
+	uint64_t numberOfSamplesInCircle = 0;
+
+	Rng_Stream stream;
+	Rng_Stream_Init(&stream, seed, 0);
+	Rng_Stream_Seek(&stream, first_toss * Words_Per_Toss);
+
+	for (uint64_t i = 0; i < number_of_tosses; i++)
+	{
+		float x = (float)(int32_t)Rng_Next_U32(&stream);
+		float y = (float)(int32_t)Rng_Next_U32(&stream);
+		numberOfSamplesInCircle += x * x + y * y < 0x1p62f;
+	}
+
+	return numberOfSamplesInCircle;
+}
+
+// The double test of the other kernels on one toss, used by the mixed kernel near the boundary
+static inline int In_Circle_Double(int32_t x_word, int32_t y_word)
+{
+	double x = x_word;
+	double y = y_word;
+	return x * x + y * y < 0x1p62;
+}
+
+// Adds one to the 32 bit lanes of hits where the 16 points (x, y) are in the
+// circle. With check_boundary the lanes close to it are left out and their
+// double test is added to *boundary_hits instead
+TARGET_AVX512
+static inline __m512i Accumulate_Hits_Float_Avx512(__m512i hits, __m512i x, __m512i y, const int check_boundary,
+												   uint64_t *boundary_hits)
+{
+	const __m512 limit = _mm512_set1_ps(0x1p62f);
+
+	__m512 xf = _mm512_cvtepi32_ps(x);
+	__m512 yf = _mm512_cvtepi32_ps(y);
+	__m512 radius = _mm512_add_ps(_mm512_mul_ps(xf, xf), _mm512_mul_ps(yf, yf));
+	__mmask16 inside = _mm512_cmp_ps_mask(radius, limit, _CMP_LT_OQ);
+
+	if (check_boundary)
+	{
+		__m512 distance = _mm512_abs_ps(_mm512_sub_ps(radius, limit));
+		__mmask16 near = _mm512_cmp_ps_mask(distance, _mm512_set1_ps(0x1p62f * Mixed_Margin), _CMP_LT_OQ);
+		if (near != 0)
+		{
+			_Alignas(64) int32_t xs[16], ys[16];
+			_mm512_store_si512(xs, x);
+			_mm512_store_si512(ys, y);
+			for (int lane = 0; lane < 16; lane++)
+			{
+				if (near & (1u << lane))
+				{
+					*boundary_hits += In_Circle_Double(xs[lane], ys[lane]);
+				}
+			}
+			inside &= (__mmask16)~near;
+		}
+	}
+
+	return _mm512_mask_add_epi32(hits, inside, hits, _mm512_set1_epi32(1));
+}
+
+// Shared body of the single precision AVX-512 kernels
+TARGET_AVX512
+static inline __attribute__((always_inline))
+uint64_t Count_In_Circle_Avx512_Float_Loop(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed,
+										   const int check_boundary)
+{
+	const uint64_t Blocks_Per_Step = 16;
+	// A 32 bit lane gains at most 2 hits per step
+	const uint64_t Steps_Per_Flush = UINT64_C(1) << 30;
+
+	uint64_t toss = first_toss;
+	uint64_t endToss = first_toss + number_of_tosses;
+	uint64_t numberOfSamplesInCircle = 0;
+
+	// The mixed kernel returns the double count, so its odd tosses are counted in double too
+	Circle_Count_Fn countScalar = check_boundary ? Count_In_Circle_Scalar : Count_In_Circle_Scalar_Float;
+
+	if (toss % Tosses_Per_Block != 0 && toss < endToss)
+	{
+		numberOfSamplesInCircle += countScalar(toss, 1, seed);
+		toss++;
+	}
+
+	Philox_Key key = Philox_Make_Key(seed);
+	uint64_t block = toss / Tosses_Per_Block;
+	uint64_t steps = (endToss - toss) / (Tosses_Per_Block * Blocks_Per_Step);
+
+	for (uint64_t flushStart = 0; flushStart < steps; flushStart += Steps_Per_Flush)
+	{
+		uint64_t flushEnd = steps - flushStart < Steps_Per_Flush ? steps : flushStart + Steps_Per_Flush;
+		__m512i hits = _mm512_setzero_si512();
+
+		for (uint64_t step = flushStart; step < flushEnd; step++, block += Blocks_Per_Step)
+		{
+			__m512i c[4];
+			Philox_Counters_Avx512(c, block, 0);
+			Philox4x32_Avx512(c, key);
+
+			hits = Accumulate_Hits_Float_Avx512(hits, c[0], c[1], check_boundary, &numberOfSamplesInCircle);
+			hits = Accumulate_Hits_Float_Avx512(hits, c[2], c[3], check_boundary, &numberOfSamplesInCircle);
+		}
+
+		// Widened before the sum, 16 lanes of up to 2^31 hits don't fit in 32 bits
+		numberOfSamplesInCircle += (uint64_t)_mm512_reduce_add_epi64(_mm512_cvtepu32_epi64(_mm512_castsi512_si256(hits)));
+		numberOfSamplesInCircle += (uint64_t)_mm512_reduce_add_epi64(_mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(hits, 1)));
+	}
+
+	toss += steps * Tosses_Per_Block * Blocks_Per_Step;
+	numberOfSamplesInCircle += countScalar(toss, endToss - toss, seed);
+
+	return numberOfSamplesInCircle;
+}
+
+TARGET_AVX512
+static uint64_t Count_In_Circle_Avx512_Float(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed)
+{
+	return Count_In_Circle_Avx512_Float_Loop(first_toss, number_of_tosses, seed, 0);
+}
+
+TARGET_AVX512
+static uint64_t Count_In_Circle_Avx512_Mixed(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed)
+{
+	return Count_In_Circle_Avx512_Float_Loop(first_toss, number_of_tosses, seed, 1);
+}
+
+/* ------------------------------------------------------------ Buffered --- */
+
+// Consumer of the buffered kernel, the double test of the other kernels on a buffer of tosses
+__attribute__((target_clones("avx512f", "avx2", "default")))
+static uint64_t Count_Buffer_In_Circle(const int32_t *xs, const int32_t *ys, size_t number_of_tosses)
+{
+	uint64_t numberOfSamplesInCircle = 0;
+	for (size_t i = 0; i < number_of_tosses; i++)
+	{
+		double x = xs[i];
+		double y = ys[i];
+		numberOfSamplesInCircle += x * x + y * y < 0x1p62;
+	}
+	return numberOfSamplesInCircle;
+}
+
+static uint64_t Count_In_Circle_Buffered(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed)
+{
+	_Alignas(64) int32_t xs[TOSS_BUFFER_SIZE];
+	_Alignas(64) int32_t ys[TOSS_BUFFER_SIZE];
+
+	Toss_Fill_Fn fill = Toss_Generator_Active()->fill;
+	uint64_t numberOfSamplesInCircle = 0;
+
+	for (uint64_t toss = first_toss; toss < first_toss + number_of_tosses; toss += TOSS_BUFFER_SIZE)
+	{
+		size_t tosses = first_toss + number_of_tosses - toss < TOSS_BUFFER_SIZE
+			? (size_t)(first_toss + number_of_tosses - toss) : TOSS_BUFFER_SIZE;
+
+		fill(toss, tosses, seed, xs, ys);
+		numberOfSamplesInCircle += Count_Buffer_In_Circle(xs, ys, tosses);
+	}
+
+	return numberOfSamplesInCircle;
+}
+
+/* ------------------------------------------------------------ Dispatch --- */
+
+// The double kernels come first, ordered from the narrowest to the widest,
+// so Circle_Kernel_Best keeps using the floating point test by default
+static const Circle_Kernel Kernels[] = {
+	{ "scalar",     Count_In_Circle_Scalar,     Always_Supported },
+	{ "avx2",       Count_In_Circle_Avx2,       Avx2_Supported },
+	{ "avx512",     Count_In_Circle_Avx512,     Avx512_Supported },
+	{ "scalar-int", Count_In_Circle_Scalar_Int, Always_Supported },
+	{ "avx2-int",   Count_In_Circle_Avx2_Int,   Avx2_Supported },
+	{ "avx512-int", Count_In_Circle_Avx512_Int, Avx512_Supported },
+	{ "buffered",   Count_In_Circle_Buffered,   Always_Supported },
+	{ "scalar-float", Count_In_Circle_Scalar_Float, Always_Supported },
+	{ "avx512-float", Count_In_Circle_Avx512_Float, Avx512_Supported },
+	{ "avx512-mixed", Count_In_Circle_Avx512_Mixed, Avx512_Supported },
+};
+
+static const int Number_Of_Kernels = sizeof(Kernels) / sizeof(Kernels[0]);
+
+const Circle_Kernel *Circle_Kernel_Find(const char *name)
+{
+	for (int i = 0; i < Number_Of_Kernels; i++)
+	{
+		if (strcmp(Kernels[i].name, name) == 0)
+		{
+			return &Kernels[i];
+		}
+	}
+	return NULL;
+}
+
+const Circle_Kernel *Circle_Kernel_Get(int index)
+{
+	return index >= 0 && index < Number_Of_Kernels ? &Kernels[index] : NULL;
+}
+
+const Circle_Kernel *Circle_Kernel_Best(void)
+{
+	const Circle_Kernel *best = &Kernels[0];
+	for (int i = 1; i < Number_Of_Kernels && Kernels[i].count != Count_In_Circle_Scalar_Int; i++)
+	{
+		if (Kernels[i].is_supported())
+		{
+			best = &Kernels[i];
+		}
+	}
+	return best;
+}
+
+void Circle_Kernel_Print_All(void)
+{
+	for (int i = 0; i < Number_Of_Kernels; i++)
+	{
+		printf("  %-12s%s\n", Kernels[i].name, Kernels[i].is_supported() ? "" : " (not supported by this CPU)");
+	}
+}
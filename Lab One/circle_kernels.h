@@ -0,0 +1,38 @@
+#ifndef LAB1_CIRCLE_KERNELS_H
+#define LAB1_CIRCLE_KERNELS_H
+
+#include <stdint.h>
+
+/*
+ * Kernels that count how many tosses of the global Philox sequence land in
+ * the unit circle. Toss i reads the words 2i (x) and 2i+1 (y) of stream 0,
+ * so every kernel sees exactly the same points. The double kernels return
+ * exactly the same count and only differ in how many points they test per
+ * instruction; the "-int" kernels do the test in exact integer arithmetic
+ * and the "-float" ones in single precision (see circle_kernels.c for the
+ * bias that introduces).
+ */
+
+// Counts the tosses [first_toss, first_toss + number_of_tosses) inside the circle
+typedef uint64_t (*Circle_Count_Fn)(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed);
+
+typedef struct Circle_Kernel {
+	const char *name;
+	Circle_Count_Fn count;
+	// Returns non zero when the running CPU can execute the kernel
+	int (*is_supported)(void);
+} Circle_Kernel;
+
+// Returns the kernel with the given name, or NULL if there is no such kernel
+const Circle_Kernel *Circle_Kernel_Find(const char *name);
+
+// Returns the kernel at index, or NULL once index is past the last kernel
+const Circle_Kernel *Circle_Kernel_Get(int index);
+
+// Returns the widest floating point kernel supported by the running CPU
+const Circle_Kernel *Circle_Kernel_Best(void);
+
+// Writes the names of every kernel, marking the ones this CPU can't run
+void Circle_Kernel_Print_All(void);
+
+#endif //LAB1_CIRCLE_KERNELS_H
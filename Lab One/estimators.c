@@ -0,0 +1,185 @@
+#include <math.h>
+#include <string.h>
+
+#include "estimators.h"
+#include "rng.h"
+
+// Estimators read their own Philox stream, point i using words 2i and 2i + 1
+#define ESTIMATOR_STREAM UINT32_C(0x2000)
+
+// Known mean of the control variate u^2 + v^2 over [0, 1)^2
+static const double Control_Mean = 2.0 / 3.0;
+
+// Returns a random value between 0 and 1
+static inline double Next_Unit(Rng_Stream *stream)
+{
+	return (Rng_Next_U32(stream) + 0.5) * 0x1p-32;
+}
+
+static inline double Quarter_Circle(double u, double v)
+{
+	return u * u + v * v < 1 ? 4.0 : 0.0;
+}
+
+static void Open_Stream(Rng_Stream *stream, uint64_t first_point, uint64_t seed)
+{
+	Rng_Stream_Init(stream, seed, ESTIMATOR_STREAM);
+	Rng_Stream_Seek(stream, first_point * 2);
+}
+
+static void Hit_Miss_Batch(uint64_t first_point, uint64_t seed, double *estimate, double *control_mean)
+{
+	Rng_Stream stream;
+	Open_Stream(&stream, first_point, seed);
+
+	double sum = 0;
+	for (int i = 0; i < ESTIMATOR_BATCH_SIZE; i++)
+	{
+		double u = Next_Unit(&stream);
+		double v = Next_Unit(&stream);
+		sum += Quarter_Circle(u, v);
+	}
+
+	*estimate = sum / ESTIMATOR_BATCH_SIZE;
+	*control_mean = 0;
+}
+
+static void Antithetic_Batch(uint64_t first_point, uint64_t seed, double *estimate, double *control_mean)
+{
+	Rng_Stream stream;
+	Open_Stream(&stream, first_point, seed);
+
+	// Each random point is evaluated together with its reflection, so a batch
+	// is half as many pairs and costs the same number of random words
+	double sum = 0;
+	for (int i = 0; i < ESTIMATOR_BATCH_SIZE / 2; i++)
+	{
+		double u = Next_Unit(&stream);
+		double v = Next_Unit(&stream);
+		sum += Quarter_Circle(u, v) + Quarter_Circle(1 - u, 1 - v);
+	}
+
+	*estimate = sum / ESTIMATOR_BATCH_SIZE;
+	*control_mean = 0;
+}
+
+static void Stratified_Batch(uint64_t first_point, uint64_t seed, double *estimate, double *control_mean)
+{
+	Rng_Stream stream;
+	Open_Stream(&stream, first_point, seed);
+
+	const double cellSize = 1.0 / ESTIMATOR_GRID_SIZE;
+
+	double sum = 0;
+	for (int row = 0; row < ESTIMATOR_GRID_SIZE; row++)
+	{
+		for (int column = 0; column < ESTIMATOR_GRID_SIZE; column++)
+		{
+			double u = (column + Next_Unit(&stream)) * cellSize;
+			double v = (row + Next_Unit(&stream)) * cellSize;
+			sum += Quarter_Circle(u, v);
+		}
+	}
+
+	*estimate = sum / ESTIMATOR_BATCH_SIZE;
+	*control_mean = 0;
+}
+
+static void Control_Variate_Batch(uint64_t first_point, uint64_t seed, double *estimate, double *control_mean)
+{
+	Rng_Stream stream;
+	Open_Stream(&stream, first_point, seed);
+
+	double sum = 0, controlSum = 0;
+	for (int i = 0; i < ESTIMATOR_BATCH_SIZE; i++)
+	{
+		double u = Next_Unit(&stream);
+		double v = Next_Unit(&stream);
+		sum += Quarter_Circle(u, v);
+		controlSum += u * u + v * v;
+	}
+
+	*estimate = sum / ESTIMATOR_BATCH_SIZE;
+	*control_mean = controlSum / ESTIMATOR_BATCH_SIZE;
+}
+
+static const Pi_Estimator Estimators[] = {
+	{ "hit-miss",   "plain hit or miss sampling",                   Hit_Miss_Batch,        0 },
+	{ "antithetic", "pairs of (u, v) and (1 - u, 1 - v)",           Antithetic_Batch,      0 },
+	{ "stratified", "one jittered point per cell of a 64x64 grid",  Stratified_Batch,      0 },
+	{ "control",    "control variate u^2 + v^2 with known mean 2/3", Control_Variate_Batch, 1 },
+};
+
+static const int Number_Of_Estimators = sizeof(Estimators) / sizeof(Estimators[0]);
+
+const Pi_Estimator *Estimator_Find(const char *name)
+{
+	for (int i = 0; i < Number_Of_Estimators; i++)
+	{
+		if (strcmp(Estimators[i].name, name) == 0)
+		{
+			return &Estimators[i];
+		}
+	}
+	return NULL;
+}
+
+const Pi_Estimator *Estimator_Get(int index)
+{
+	return index >= 0 && index < Number_Of_Estimators ? &Estimators[index] : NULL;
+}
+
+void Estimator_Run_Batches(const Pi_Estimator *estimator, uint64_t first_batch, uint64_t number_of_batches,
+                           uint64_t seed, Estimator_Sums *sums)
+{
+	for (uint64_t batch = first_batch; batch < first_batch + number_of_batches; batch++)
+	{
+		double y, c;
+		estimator->batch(batch * ESTIMATOR_BATCH_SIZE, seed, &y, &c);
+
+		sums->batches++;
+		sums->sumY += y;
+		sums->sumC += c;
+		sums->sumYY += y * y;
+		sums->sumCC += c * c;
+		sums->sumYC += y * c;
+	}
+}
+
+void Estimator_Sums_Merge(Estimator_Sums *into, const Estimator_Sums *from)
+{
+	into->batches += from->batches;
+	into->sumY += from->sumY;
+	into->sumC += from->sumC;
+	into->sumYY += from->sumYY;
+	into->sumCC += from->sumCC;
+	into->sumYC += from->sumYC;
+}
+
+Estimator_Report Estimator_Finish(const Pi_Estimator *estimator, const Estimator_Sums *sums)
+{
+	double n = (double)sums->batches;
+	double meanY = sums->sumY / n;
+	double meanC = sums->sumC / n;
+
+	double varianceY = (sums->sumYY - n * meanY * meanY) / (n - 1);
+	double varianceC = (sums->sumCC - n * meanC * meanC) / (n - 1);
+	double covariance = (sums->sumYC - n * meanY * meanC) / (n - 1);
+
+	double estimate = meanY;
+	double variance = varianceY;
+	if (estimator->usesControlVariate && varianceC > 0)
+	{
+		// The beta minimising var(y - beta c), fitted on the same batches
+		double beta = covariance / varianceC;
+		estimate = meanY - beta * (meanC - Control_Mean);
+		variance = varianceY - beta * covariance;
+	}
+
+	Estimator_Report report;
+	report.estimate = estimate;
+	report.standardError = sqrt(fmax(variance, 0) / n);
+	report.variancePerSample = variance * ESTIMATOR_BATCH_SIZE;
+	report.samples = sums->batches * ESTIMATOR_BATCH_SIZE;
+	return report;
+}
@@ -0,0 +1,65 @@
+#ifndef LAB1_ESTIMATORS_H
+#define LAB1_ESTIMATORS_H
+
+#include <stdint.h>
+
+/*
+ * Variance reduced estimators of pi.
+ *
+ * All estimators work on the quarter circle, points (u, v) in [0, 1)^2 with
+ * f(u, v) = 4 if u^2 + v^2 < 1, and process the tosses in batches of
+ * ESTIMATOR_BATCH_SIZE points. Every batch produces one estimate of pi, and
+ * the spread of the batch estimates gives the variance of each estimator
+ * without having to know its formula, which is what makes the stratified
+ * estimator comparable with the others.
+ *
+ *   hit-miss    f(u, v), the plain estimator for reference
+ *   antithetic  (f(u, v) + f(1 - u, 1 - v)) / 2, half as many pairs as points
+ *   stratified  one jittered point in each cell of a 64 x 64 grid per batch
+ *   control     f(u, v) - beta (u^2 + v^2 - 2/3), with beta fitted over the run
+ */
+
+#define ESTIMATOR_GRID_SIZE 64
+#define ESTIMATOR_BATCH_SIZE (ESTIMATOR_GRID_SIZE * ESTIMATOR_GRID_SIZE)
+
+// Running sums over the batch estimates y and control variate means c
+typedef struct Estimator_Sums {
+	uint64_t batches;
+	double sumY, sumC;
+	double sumYY, sumCC, sumYC;
+} Estimator_Sums;
+
+typedef struct Estimator_Report {
+	double estimate;
+	double standardError;
+	// Variance of a single point, batch variance * batch size, so the
+	// estimators can be compared per random point they consume
+	double variancePerSample;
+	uint64_t samples;
+} Estimator_Report;
+
+typedef struct Pi_Estimator {
+	const char *name;
+	const char *description;
+	// Draws one batch starting at the given point of the estimator stream and returns its estimate and control mean
+	void (*batch)(uint64_t first_point, uint64_t seed, double *estimate, double *control_mean);
+	int usesControlVariate;
+} Pi_Estimator;
+
+// Returns the estimator with the given name, or NULL if there is no such estimator
+const Pi_Estimator *Estimator_Find(const char *name);
+
+// Returns the estimator at index, or NULL once index is past the last estimator
+const Pi_Estimator *Estimator_Get(int index);
+
+// Adds the batches [first_batch, first_batch + number_of_batches) to sums
+void Estimator_Run_Batches(const Pi_Estimator *estimator, uint64_t first_batch, uint64_t number_of_batches,
+                           uint64_t seed, Estimator_Sums *sums);
+
+// Adds the batches summed in from to into
+void Estimator_Sums_Merge(Estimator_Sums *into, const Estimator_Sums *from);
+
+// Turns the batch sums into the estimate, its standard error and the variance per point
+Estimator_Report Estimator_Finish(const Pi_Estimator *estimator, const Estimator_Sums *sums);
+
+#endif //LAB1_ESTIMATORS_H
@@ -0,0 +1,337 @@
+#include <math.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "fused_estimators.h"
+#include "rng.h"
+#include "philox_simd.h"
+
+/*
+ * Vector i reads block i of two Philox streams, coordinates 0 to 3 from
+ * FUSED_STREAM and 4 to 7 from FUSED_STREAM + 1, so the vector kernels get
+ * all 8 coordinates of 8 or 16 consecutive vectors from one Philox call per
+ * stream. Like the circle kernels the tests are done on the raw signed words
+ * scaled by 2^31 in each coordinate, the ball test becomes sum < 2^62 and the
+ * needle test |x_2| sqrt(x_0^2 + x_1^2) < |x_1| 2^31. The radius is summed in
+ * the same order on every path and this file is compiled with
+ * -ffp-contract=off, so every kernel makes the same decisions.
+ */
+
+#define FUSED_STREAM UINT32_C(0x3000)
+
+static void Count_Fused_Scalar(uint64_t first_vector, uint64_t number_of_vectors, uint64_t seed, Fused_Counts *counts)
+{
+	Philox_Key key = Philox_Make_Key(seed);
+	uint64_t inBall[FUSED_DIMENSIONS + 1] = { 0 };
+	uint64_t needleCrossings = 0;
+
+	for (uint64_t vector = first_vector; vector < first_vector + number_of_vectors; vector++)
+	{
+		Philox_Block low = Philox4x32(Philox_Make_Counter(vector, FUSED_STREAM), key);
+		Philox_Block high = Philox4x32(Philox_Make_Counter(vector, FUSED_STREAM + 1), key);
+
+		double x[FUSED_DIMENSIONS];
+		for (int k = 0; k < 4; k++)
+		{
+			x[k] = (int32_t)low.v[k];
+			x[k + 4] = (int32_t)high.v[k];
+		}
+
+		double radius = x[0] * x[0] + x[1] * x[1];
+		int inCircle = radius < 0x1p62;
+		inBall[2] += inCircle;
+		needleCrossings += inCircle && fabs(x[2]) * sqrt(radius) < fabs(x[1]) * 0x1p31;
+
+		for (int d = 3; d <= FUSED_DIMENSIONS; d++)
+		{
+			radius = radius + x[d - 1] * x[d - 1];
+			inBall[d] += radius < 0x1p62;
+		}
+	}
+
+	counts->vectors += number_of_vectors;
+	for (int d = 2; d <= FUSED_DIMENSIONS; d++)
+	{
+		counts->inBall[d] += inBall[d];
+	}
+	counts->needleCrossings += needleCrossings;
+}
+
+static int Always_Supported(void)
+{
+	return 1;
+}
+
+/* ---------------------------------------------------------------- AVX2 --- */
+
+static int Avx2_Supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+// Evaluates every estimator on 4 vectors, words[k] holding coordinate k of each
+TARGET_AVX2
+static inline void Accumulate_Fused_Avx2(__m256i in_ball[FUSED_DIMENSIONS + 1], __m256i *needle_crossings,
+										 const __m128i words[FUSED_DIMENSIONS])
+{
+	const __m256d limit = _mm256_set1_pd(0x1p62);
+	const __m256d signBit = _mm256_set1_pd(-0.0);
+
+	__m256d x0 = _mm256_cvtepi32_pd(words[0]);
+	__m256d x1 = _mm256_cvtepi32_pd(words[1]);
+	__m256d x2 = _mm256_cvtepi32_pd(words[2]);
+	__m256d radius = _mm256_add_pd(_mm256_mul_pd(x0, x0), _mm256_mul_pd(x1, x1));
+	__m256d inCircle = _mm256_cmp_pd(radius, limit, _CMP_LT_OQ);
+
+	// A true compare is all ones, which is -1 as a 64 bit integer
+	in_ball[2] = _mm256_sub_epi64(in_ball[2], _mm256_castpd_si256(inCircle));
+
+	__m256d centre = _mm256_mul_pd(_mm256_andnot_pd(signBit, x2), _mm256_sqrt_pd(radius));
+	__m256d reach = _mm256_mul_pd(_mm256_andnot_pd(signBit, x1), _mm256_set1_pd(0x1p31));
+	__m256d crossed = _mm256_and_pd(inCircle, _mm256_cmp_pd(centre, reach, _CMP_LT_OQ));
+	*needle_crossings = _mm256_sub_epi64(*needle_crossings, _mm256_castpd_si256(crossed));
+
+	radius = _mm256_add_pd(radius, _mm256_mul_pd(x2, x2));
+	in_ball[3] = _mm256_sub_epi64(in_ball[3], _mm256_castpd_si256(_mm256_cmp_pd(radius, limit, _CMP_LT_OQ)));
+
+	for (int d = 4; d <= FUSED_DIMENSIONS; d++)
+	{
+		__m256d x = _mm256_cvtepi32_pd(words[d - 1]);
+		radius = _mm256_add_pd(radius, _mm256_mul_pd(x, x));
+		in_ball[d] = _mm256_sub_epi64(in_ball[d], _mm256_castpd_si256(_mm256_cmp_pd(radius, limit, _CMP_LT_OQ)));
+	}
+}
+
+TARGET_AVX2
+static void Count_Fused_Avx2(uint64_t first_vector, uint64_t number_of_vectors, uint64_t seed, Fused_Counts *counts)
+{
+	const uint64_t Vectors_Per_Step = 8;
+
+	Philox_Key key = Philox_Make_Key(seed);
+	uint64_t steps = number_of_vectors / Vectors_Per_Step;
+	uint64_t vector = first_vector;
+
+	__m256i inBall[FUSED_DIMENSIONS + 1];
+	for (int d = 0; d <= FUSED_DIMENSIONS; d++)
+	{
+		inBall[d] = _mm256_setzero_si256();
+	}
+	__m256i needleCrossings = _mm256_setzero_si256();
+
+	for (uint64_t step = 0; step < steps; step++, vector += Vectors_Per_Step)
+	{
+		__m256i low[4], high[4];
+		Philox_Counters_Avx2(low, vector, FUSED_STREAM);
+		Philox4x32_Avx2(low, key);
+		Philox_Counters_Avx2(high, vector, FUSED_STREAM + 1);
+		Philox4x32_Avx2(high, key);
+
+		__m128i words[FUSED_DIMENSIONS];
+		for (int k = 0; k < 4; k++)
+		{
+			words[k] = _mm256_castsi256_si128(low[k]);
+			words[k + 4] = _mm256_castsi256_si128(high[k]);
+		}
+		Accumulate_Fused_Avx2(inBall, &needleCrossings, words);
+
+		for (int k = 0; k < 4; k++)
+		{
+			words[k] = _mm256_extracti128_si256(low[k], 1);
+			words[k + 4] = _mm256_extracti128_si256(high[k], 1);
+		}
+		Accumulate_Fused_Avx2(inBall, &needleCrossings, words);
+	}
+
+	uint64_t lanes[4];
+	for (int d = 2; d <= FUSED_DIMENSIONS; d++)
+	{
+		_mm256_storeu_si256((__m256i *)lanes, inBall[d]);
+		counts->inBall[d] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	}
+	_mm256_storeu_si256((__m256i *)lanes, needleCrossings);
+	counts->needleCrossings += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	counts->vectors += steps * Vectors_Per_Step;
+
+	Count_Fused_Scalar(vector, first_vector + number_of_vectors - vector, seed, counts);
+}
+
+/* ------------------------------------------------------------- AVX-512 --- */
+
+static int Avx512_Supported(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+
+// Evaluates every estimator on 8 vectors, words[k] holding coordinate k of each
+TARGET_AVX512
+static inline void Accumulate_Fused_Avx512(__m512i in_ball[FUSED_DIMENSIONS + 1], __m512i *needle_crossings,
+										   const __m256i words[FUSED_DIMENSIONS])
+{
+	const __m512d limit = _mm512_set1_pd(0x1p62);
+	const __m512i one = _mm512_set1_epi64(1);
+
+	__m512d x0 = _mm512_cvtepi32_pd(words[0]);
+	__m512d x1 = _mm512_cvtepi32_pd(words[1]);
+	__m512d x2 = _mm512_cvtepi32_pd(words[2]);
+	__m512d radius = _mm512_add_pd(_mm512_mul_pd(x0, x0), _mm512_mul_pd(x1, x1));
+	__mmask8 inCircle = _mm512_cmp_pd_mask(radius, limit, _CMP_LT_OQ);
+	in_ball[2] = _mm512_mask_add_epi64(in_ball[2], inCircle, in_ball[2], one);
+
+	__m512d centre = _mm512_mul_pd(_mm512_abs_pd(x2), _mm512_sqrt_pd(radius));
+	__m512d reach = _mm512_mul_pd(_mm512_abs_pd(x1), _mm512_set1_pd(0x1p31));
+	__mmask8 crossed = _mm512_mask_cmp_pd_mask(inCircle, centre, reach, _CMP_LT_OQ);
+	*needle_crossings = _mm512_mask_add_epi64(*needle_crossings, crossed, *needle_crossings, one);
+
+	radius = _mm512_add_pd(radius, _mm512_mul_pd(x2, x2));
+	in_ball[3] = _mm512_mask_add_epi64(in_ball[3], _mm512_cmp_pd_mask(radius, limit, _CMP_LT_OQ), in_ball[3], one);
+
+	for (int d = 4; d <= FUSED_DIMENSIONS; d++)
+	{
+		__m512d x = _mm512_cvtepi32_pd(words[d - 1]);
+		radius = _mm512_add_pd(radius, _mm512_mul_pd(x, x));
+		in_ball[d] = _mm512_mask_add_epi64(in_ball[d], _mm512_cmp_pd_mask(radius, limit, _CMP_LT_OQ), in_ball[d], one);
+	}
+}
+
+TARGET_AVX512
+static void Count_Fused_Avx512(uint64_t first_vector, uint64_t number_of_vectors, uint64_t seed, Fused_Counts *counts)
+{
+	const uint64_t Vectors_Per_Step = 16;
+
+	Philox_Key key = Philox_Make_Key(seed);
+	uint64_t steps = number_of_vectors / Vectors_Per_Step;
+	uint64_t vector = first_vector;
+
+	__m512i inBall[FUSED_DIMENSIONS + 1];
+	for (int d = 0; d <= FUSED_DIMENSIONS; d++)
+	{
+		inBall[d] = _mm512_setzero_si512();
+	}
+	__m512i needleCrossings = _mm512_setzero_si512();
+
+	for (uint64_t step = 0; step < steps; step++, vector += Vectors_Per_Step)
+	{
+		__m512i low[4], high[4];
+		Philox_Counters_Avx512(low, vector, FUSED_STREAM);
+		Philox4x32_Avx512(low, key);
+		Philox_Counters_Avx512(high, vector, FUSED_STREAM + 1);
+		Philox4x32_Avx512(high, key);
+
+		__m256i words[FUSED_DIMENSIONS];
+		for (int k = 0; k < 4; k++)
+		{
+			words[k] = _mm512_castsi512_si256(low[k]);
+			words[k + 4] = _mm512_castsi512_si256(high[k]);
+		}
+		Accumulate_Fused_Avx512(inBall, &needleCrossings, words);
+
+		for (int k = 0; k < 4; k++)
+		{
+			words[k] = _mm512_extracti64x4_epi64(low[k], 1);
+			words[k + 4] = _mm512_extracti64x4_epi64(high[k], 1);
+		}
+		Accumulate_Fused_Avx512(inBall, &needleCrossings, words);
+	}
+
+	for (int d = 2; d <= FUSED_DIMENSIONS; d++)
+	{
+		counts->inBall[d] += (uint64_t)_mm512_reduce_add_epi64(inBall[d]);
+	}
+	counts->needleCrossings += (uint64_t)_mm512_reduce_add_epi64(needleCrossings);
+	counts->vectors += steps * Vectors_Per_Step;
+
+	Count_Fused_Scalar(vector, first_vector + number_of_vectors - vector, seed, counts);
+}
+
+/* ---------------------------------------------------------- Estimators --- */
+
+// Volume of the unit ball, 2^d times the fraction of the cube [-1, 1)^d inside it
+static Fused_Estimate Finish_Ball(const Fused_Estimator *estimator, const Fused_Counts *counts)
+{
+	int d = estimator->dimensions;
+	double fraction = (double)counts->inBall[d] / counts->vectors;
+
+	Fused_Estimate result;
+	result.estimate = ldexp(fraction, d);
+	result.standardError = ldexp(sqrt(fraction * (1 - fraction) / counts->vectors), d);
+	// Inverts V_d = pi^(d/2) / Gamma(d/2 + 1)
+	result.pi = pow(result.estimate * tgamma(d / 2.0 + 1), 2.0 / d);
+	return result;
+}
+
+// A needle as long as the line spacing crosses a line with probability 2 / pi
+static Fused_Estimate Finish_Needle(const Fused_Estimator *estimator, const Fused_Counts *counts)
+{
+	(void)estimator;
+	double needles = (double)counts->inBall[2];
+	double crossing = counts->needleCrossings / needles;
+
+	Fused_Estimate result;
+	result.estimate = 2 / crossing;
+	result.standardError = result.estimate * sqrt((1 - crossing) / (crossing * needles));
+	result.pi = result.estimate;
+	return result;
+}
+
+static const Fused_Estimator Estimators[] = {
+	{ "ball2",  "area of the unit circle, pi",          3.141592653589793, Finish_Ball,   2 },
+	{ "ball3",  "volume of the unit ball in 3D",         4.1887902047863905, Finish_Ball,  3 },
+	{ "ball4",  "volume of the unit ball in 4D",         4.934802200544679, Finish_Ball,   4 },
+	{ "ball5",  "volume of the unit ball in 5D",         5.263789013914325, Finish_Ball,   5 },
+	{ "ball6",  "volume of the unit ball in 6D",         5.167712780049969, Finish_Ball,   6 },
+	{ "ball7",  "volume of the unit ball in 7D",         4.7247659703314016, Finish_Ball,  7 },
+	{ "ball8",  "volume of the unit ball in 8D",         4.058712126416768, Finish_Ball,   8 },
+	{ "needle", "Buffon's needle, pi from the crossings", 3.141592653589793, Finish_Needle, 2 },
+};
+
+static const int Number_Of_Estimators = sizeof(Estimators) / sizeof(Estimators[0]);
+
+const Fused_Estimator *Fused_Estimator_Get(int index)
+{
+	return index >= 0 && index < Number_Of_Estimators ? &Estimators[index] : NULL;
+}
+
+/* ------------------------------------------------------------ Dispatch --- */
+
+static const Fused_Kernel Kernels[] = {
+	{ "scalar", Count_Fused_Scalar, Always_Supported },
+	{ "avx2",   Count_Fused_Avx2,   Avx2_Supported },
+	{ "avx512", Count_Fused_Avx512, Avx512_Supported },
+};
+
+static const int Number_Of_Kernels = sizeof(Kernels) / sizeof(Kernels[0]);
+
+const Fused_Kernel *Fused_Kernel_Find(const char *name)
+{
+	for (int i = 0; i < Number_Of_Kernels; i++)
+	{
+		if (strcmp(Kernels[i].name, name) == 0)
+		{
+			return &Kernels[i];
+		}
+	}
+	return NULL;
+}
+
+const Fused_Kernel *Fused_Kernel_Best(void)
+{
+	const Fused_Kernel *best = &Kernels[0];
+	for (int i = 1; i < Number_Of_Kernels; i++)
+	{
+		if (Kernels[i].is_supported())
+		{
+			best = &Kernels[i];
+		}
+	}
+	return best;
+}
+
+void Fused_Counts_Merge(Fused_Counts *into, const Fused_Counts *from)
+{
+	into->vectors += from->vectors;
+	for (int d = 2; d <= FUSED_DIMENSIONS; d++)
+	{
+		into->inBall[d] += from->inBall[d];
+	}
+	into->needleCrossings += from->needleCrossings;
+}
@@ -0,0 +1,70 @@
+#ifndef LAB1_FUSED_ESTIMATORS_H
+#define LAB1_FUSED_ESTIMATORS_H
+
+#include <stdint.h>
+
+/*
+ * Estimates several constants from one pass over a single random stream.
+ *
+ * Each random vector has FUSED_DIMENSIONS coordinates in [-1, 1) and is
+ * drawn once; the kernels then evaluate every estimator on it before moving
+ * on, so the Philox cost is shared by all of them:
+ *
+ *   ball2 .. ball8  volume of the unit d-ball from the prefix x_0^2 + .. + x_{d-1}^2 < 1,
+ *                   ball2 being the circle estimate of pi
+ *   needle          Buffon's needle of length 1 on lines 1 apart, dropped once per
+ *                   point inside the circle: (x_0, x_1) gives a uniform angle and
+ *                   |x_2| / 2 the distance of the needle's centre to the nearest line
+ *
+ * The hit counters are kept per SIMD lane in the vector kernels and are
+ * plain integers, so every kernel returns exactly the same counts.
+ */
+
+#define FUSED_DIMENSIONS 8
+
+typedef struct Fused_Counts {
+	uint64_t vectors;
+	// inBall[d] counts the vectors whose first d coordinates are inside the unit ball, for d >= 2
+	uint64_t inBall[FUSED_DIMENSIONS + 1];
+	// Needles are dropped for the inBall[2] points inside the circle
+	uint64_t needleCrossings;
+} Fused_Counts;
+
+// Adds the counts of the vectors [first_vector, first_vector + number_of_vectors) to counts
+typedef void (*Fused_Count_Fn)(uint64_t first_vector, uint64_t number_of_vectors, uint64_t seed, Fused_Counts *counts);
+
+typedef struct Fused_Kernel {
+	const char *name;
+	Fused_Count_Fn count;
+	// Returns non zero when the running CPU can execute the kernel
+	int (*is_supported)(void);
+} Fused_Kernel;
+
+typedef struct Fused_Estimate {
+	double estimate;
+	double standardError;
+	// Value of pi implied by the estimate
+	double pi;
+} Fused_Estimate;
+
+typedef struct Fused_Estimator {
+	const char *name;
+	const char *description;
+	double exactValue;
+	Fused_Estimate (*finish)(const struct Fused_Estimator *estimator, const Fused_Counts *counts);
+	int dimensions;
+} Fused_Estimator;
+
+// Returns the kernel with the given name, or NULL if there is no such kernel
+const Fused_Kernel *Fused_Kernel_Find(const char *name);
+
+// Returns the widest kernel supported by the running CPU
+const Fused_Kernel *Fused_Kernel_Best(void);
+
+// Returns the estimator at index, or NULL once index is past the last estimator
+const Fused_Estimator *Fused_Estimator_Get(int index);
+
+// Adds the counts in from to into
+void Fused_Counts_Merge(Fused_Counts *into, const Fused_Counts *from);
+
+#endif //LAB1_FUSED_ESTIMATORS_H
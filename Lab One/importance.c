@@ -0,0 +1,489 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <omp.h>
+
+#include "importance.h"
+#include "block_scheduler.h"
+#include "rng.h"
+#include "statistics.h"
+
+// Width of the peaks of the test integrands
+static const double Peak_Sigma = 0.05;
+
+// Damping of the grid refinement, smaller values adapt more slowly but more steadily
+static const double Grid_Damping = 0.5;
+
+typedef struct Truncated_Gaussian {
+	double mean;
+	double sigma;
+	// Normal CDF at the lower end of the box, and between its ends
+	double cdfLower;
+	double cdfRange;
+	// 1 / (sqrt(2 pi) sigma cdfRange), the density at the mean
+	double densityScale;
+} Truncated_Gaussian;
+
+struct Proposal_State {
+	int dimensions;
+	Integration_Box box;
+	double volume;
+	int numberOfComponents;
+	double componentWeight[IMPORTANCE_MAX_COMPONENTS];
+	// Upper end of each component's share of [0, 1) for the component uniform
+	double componentLimit[IMPORTANCE_MAX_COMPONENTS];
+	Truncated_Gaussian gaussians[IMPORTANCE_MAX_COMPONENTS][IMPORTANCE_MAX_DIMENSIONS];
+	double edges[IMPORTANCE_MAX_DIMENSIONS][IMPORTANCE_GRID_BINS + 1];
+};
+
+static inline double Normal_Cdf(double z)
+{
+	return 0.5 * erfc(-z * M_SQRT1_2);
+}
+
+static void Prepare_Box(Proposal_State *state, const Importance_Problem *problem)
+{
+	memset(state, 0, sizeof(*state));
+	state->dimensions = problem->box.dimensions;
+	state->box = problem->box;
+	state->volume = 1;
+	for (int d = 0; d < state->dimensions; d++)
+	{
+		state->volume *= problem->box.upper[d] - problem->box.lower[d];
+	}
+}
+
+static void Prepare_Components(Proposal_State *state, const Importance_Problem *problem,
+							   const Gaussian_Component *components, int number_of_components)
+{
+	Prepare_Box(state, problem);
+	state->numberOfComponents = number_of_components;
+
+	double totalWeight = 0;
+	for (int k = 0; k < number_of_components; k++)
+	{
+		totalWeight += components[k].weight;
+	}
+
+	double limit = 0;
+	for (int k = 0; k < number_of_components; k++)
+	{
+		state->componentWeight[k] = components[k].weight / totalWeight;
+		limit += state->componentWeight[k];
+		state->componentLimit[k] = limit;
+
+		for (int d = 0; d < state->dimensions; d++)
+		{
+			Truncated_Gaussian *gaussian = &state->gaussians[k][d];
+			gaussian->mean = components[k].mean[d];
+			gaussian->sigma = components[k].sigma[d];
+			gaussian->cdfLower = Normal_Cdf((problem->box.lower[d] - gaussian->mean) / gaussian->sigma);
+			gaussian->cdfRange = Normal_Cdf((problem->box.upper[d] - gaussian->mean) / gaussian->sigma) - gaussian->cdfLower;
+			gaussian->densityScale = 1 / (sqrt(2 * M_PI) * gaussian->sigma * gaussian->cdfRange);
+		}
+	}
+	// Rounding must not leave a gap below 1
+	state->componentLimit[number_of_components - 1] = 1;
+}
+
+static void Uniform_Prepare(Proposal_State *state, const Importance_Problem *problem)
+{
+	Prepare_Box(state, problem);
+}
+
+static double Uniform_Sample(const Proposal_State *state, const double *u, double *x)
+{
+	for (int d = 0; d < state->dimensions; d++)
+	{
+		x[d] = state->box.lower[d] + u[d + 1] * (state->box.upper[d] - state->box.lower[d]);
+	}
+	return 1 / state->volume;
+}
+
+static void Gaussian_Prepare(Proposal_State *state, const Importance_Problem *problem)
+{
+	Gaussian_Component component = problem->gaussian;
+	component.weight = 1;
+	Prepare_Components(state, problem, &component, 1);
+}
+
+static void Mixture_Prepare(Proposal_State *state, const Importance_Problem *problem)
+{
+	Prepare_Components(state, problem, problem->components, problem->numberOfComponents);
+}
+
+// Draws from one component by inverting its truncated CDFs, the density is
+// the mixture of all components since any of them could have produced x
+static double Mixture_Sample(const Proposal_State *state, const double *u, double *x)
+{
+	int component = 0;
+	while (u[0] >= state->componentLimit[component])
+	{
+		component++;
+	}
+
+	for (int d = 0; d < state->dimensions; d++)
+	{
+		const Truncated_Gaussian *gaussian = &state->gaussians[component][d];
+		// The approximation is off by about 1e-9 relative, and since q is evaluated exactly at
+		// the point drawn the estimate is off by that much at most, far below its standard error
+		double z = Normal_Quantile_Approximate(gaussian->cdfLower + u[d + 1] * gaussian->cdfRange);
+		x[d] = fmin(fmax(gaussian->mean + gaussian->sigma * z, state->box.lower[d]), state->box.upper[d]);
+	}
+
+	double density = 0;
+	for (int k = 0; k < state->numberOfComponents; k++)
+	{
+		double exponent = 0, scale = state->componentWeight[k];
+		for (int d = 0; d < state->dimensions; d++)
+		{
+			const Truncated_Gaussian *gaussian = &state->gaussians[k][d];
+			double z = (x[d] - gaussian->mean) / gaussian->sigma;
+			exponent += z * z;
+			scale *= gaussian->densityScale;
+		}
+		density += scale * exp(-0.5 * exponent);
+	}
+	return density;
+}
+
+static void Vegas_Prepare(Proposal_State *state, const Importance_Problem *problem)
+{
+	Prepare_Box(state, problem);
+	for (int d = 0; d < state->dimensions; d++)
+	{
+		double width = problem->box.upper[d] - problem->box.lower[d];
+		for (int i = 0; i <= IMPORTANCE_GRID_BINS; i++)
+		{
+			state->edges[d][i] = problem->box.lower[d] + width * i / IMPORTANCE_GRID_BINS;
+		}
+		state->edges[d][IMPORTANCE_GRID_BINS] = problem->box.upper[d];
+	}
+}
+
+// Every bin is equally likely, so narrow bins have a high density
+static double Vegas_Sample(const Proposal_State *state, const double *u, double *x)
+{
+	double density = 1;
+	for (int d = 0; d < state->dimensions; d++)
+	{
+		double position = u[d + 1] * IMPORTANCE_GRID_BINS;
+		int bin = (int)position;
+		double width = state->edges[d][bin + 1] - state->edges[d][bin];
+		x[d] = state->edges[d][bin] + (position - bin) * width;
+		density *= 1 / (IMPORTANCE_GRID_BINS * width);
+	}
+	return density;
+}
+
+// Lepage's refinement: the bins are redrawn so that each holds an equal share
+// of the smoothed and damped sums of w^2, which shrinks the bins where the
+// weights are large and so lowers them
+static void Vegas_Refine(Proposal_State *state, double bin_weights[][IMPORTANCE_GRID_BINS])
+{
+	for (int d = 0; d < state->dimensions; d++)
+	{
+		const double *weights = bin_weights[d];
+		double smoothed[IMPORTANCE_GRID_BINS];
+		double total = 0;
+		for (int i = 0; i < IMPORTANCE_GRID_BINS; i++)
+		{
+			double sum = weights[i], neighbours = 1;
+			if (i > 0)
+			{
+				sum += weights[i - 1];
+				neighbours++;
+			}
+			if (i < IMPORTANCE_GRID_BINS - 1)
+			{
+				sum += weights[i + 1];
+				neighbours++;
+			}
+			smoothed[i] = sum / neighbours;
+			total += smoothed[i];
+		}
+		if (total <= 0)
+		{
+			continue;
+		}
+
+		double importance[IMPORTANCE_GRID_BINS];
+		double totalImportance = 0;
+		for (int i = 0; i < IMPORTANCE_GRID_BINS; i++)
+		{
+			double share = smoothed[i] / total;
+			importance[i] = share <= 0 ? 0 : share >= 1 ? 1 : pow((1 - share) / log(1 / share), Grid_Damping);
+			totalImportance += importance[i];
+		}
+
+		double newEdges[IMPORTANCE_GRID_BINS + 1];
+		double perBin = totalImportance / IMPORTANCE_GRID_BINS;
+		double used = 0;
+		int bin = 0;
+		newEdges[0] = state->edges[d][0];
+		for (int i = 1; i < IMPORTANCE_GRID_BINS; i++)
+		{
+			double needed = perBin;
+			while (bin < IMPORTANCE_GRID_BINS - 1 && needed > importance[bin] - used)
+			{
+				needed -= importance[bin] - used;
+				used = 0;
+				bin++;
+			}
+			used += needed;
+			double fraction = importance[bin] > 0 ? fmin(used / importance[bin], 1) : 1;
+			newEdges[i] = state->edges[d][bin] + fraction * (state->edges[d][bin + 1] - state->edges[d][bin]);
+		}
+		newEdges[IMPORTANCE_GRID_BINS] = state->edges[d][IMPORTANCE_GRID_BINS];
+
+		memcpy(state->edges[d], newEdges, sizeof(newEdges));
+	}
+}
+
+// Gaussian peak of width Peak_Sigma centred on (centre, ..., centre) in four dimensions
+static inline double Peak4(const double *x, double centre)
+{
+	double radius = 0;
+	for (int d = 0; d < 4; d++)
+	{
+		radius += (x[d] - centre) * (x[d] - centre);
+	}
+	return exp(-radius / (2 * Peak_Sigma * Peak_Sigma));
+}
+
+static double Single_Peak(const double *x)
+{
+	return Peak4(x, 0.5);
+}
+
+static double Twin_Peak(const double *x)
+{
+	return 0.5 * (Peak4(x, 0.3) + Peak4(x, 0.7));
+}
+
+// The proposals are a little wider than the peaks so the weights stay bounded
+// in the tails, and the mixtures keep a wide component as a safety net
+static const Importance_Problem Problems[] = {
+	{ "peak", "Gaussian peak of width 0.05 at the centre of [0, 1]^4 (pi^2 / 40000)", Single_Peak,
+	  { 4, { 0, 0, 0, 0 }, { 1, 1, 1, 1 } }, 2.467401100272339e-4,
+	  { 1, { 0.5, 0.5, 0.5, 0.5 }, { 0.06, 0.06, 0.06, 0.06 } },
+	  2, { { 0.9, { 0.5, 0.5, 0.5, 0.5 }, { 0.06, 0.06, 0.06, 0.06 } },
+		   { 0.1, { 0.5, 0.5, 0.5, 0.5 }, { 0.3, 0.3, 0.3, 0.3 } } } },
+	{ "twin-peak", "two such peaks at 0.3 and 0.7 on the diagonal of [0, 1]^4", Twin_Peak,
+	  { 4, { 0, 0, 0, 0 }, { 1, 1, 1, 1 } }, 2.467401090535109e-4,
+	  { 1, { 0.5, 0.5, 0.5, 0.5 }, { 0.2, 0.2, 0.2, 0.2 } },
+	  3, { { 0.45, { 0.3, 0.3, 0.3, 0.3 }, { 0.06, 0.06, 0.06, 0.06 } },
+		   { 0.45, { 0.7, 0.7, 0.7, 0.7 }, { 0.06, 0.06, 0.06, 0.06 } },
+		   { 0.1, { 0.5, 0.5, 0.5, 0.5 }, { 0.3, 0.3, 0.3, 0.3 } } } },
+};
+
+static const int Number_Of_Problems = sizeof(Problems) / sizeof(Problems[0]);
+
+static const Importance_Proposal Proposals[] = {
+	{ "uniform",  "uniform points over the box",                            Uniform_Prepare,  Uniform_Sample, NULL },
+	{ "gaussian", "truncated Gaussian supplied by the problem",             Gaussian_Prepare, Mixture_Sample, NULL },
+	{ "mixture",  "mixture of truncated Gaussians supplied by the problem", Mixture_Prepare,  Mixture_Sample, NULL },
+	{ "vegas",    "separable grid refined between iterations",              Vegas_Prepare,    Vegas_Sample,   Vegas_Refine },
+};
+
+static const int Number_Of_Proposals = sizeof(Proposals) / sizeof(Proposals[0]);
+
+const Importance_Problem *Importance_Problem_Find(const char *name)
+{
+	for (int i = 0; i < Number_Of_Problems; i++)
+	{
+		if (strcmp(Problems[i].name, name) == 0)
+		{
+			return &Problems[i];
+		}
+	}
+	return NULL;
+}
+
+void Importance_Problem_Print_All(void)
+{
+	for (int i = 0; i < Number_Of_Problems; i++)
+	{
+		printf("  %-12s%s\n", Problems[i].name, Problems[i].description);
+	}
+}
+
+const Importance_Proposal *Importance_Proposal_Find(const char *name)
+{
+	for (int i = 0; i < Number_Of_Proposals; i++)
+	{
+		if (strcmp(Proposals[i].name, name) == 0)
+		{
+			return &Proposals[i];
+		}
+	}
+	return NULL;
+}
+
+const Importance_Proposal *Importance_Proposal_Get(int index)
+{
+	return index >= 0 && index < Number_Of_Proposals ? &Proposals[index] : NULL;
+}
+
+void Importance_Proposal_Print_All(void)
+{
+	for (int i = 0; i < Number_Of_Proposals; i++)
+	{
+		printf("  %-12s%s\n", Proposals[i].name, Proposals[i].description);
+	}
+}
+
+typedef struct Importance_Sums {
+	double sumW;
+	double sumWW;
+	double binWeights[IMPORTANCE_MAX_DIMENSIONS][IMPORTANCE_GRID_BINS];
+} Importance_Sums;
+
+typedef struct Importance_Blocks {
+	const Importance_Problem *problem;
+	const Importance_Proposal *proposal;
+	const Proposal_State *state;
+	uint64_t firstSample;
+	uint64_t numberOfSamples;
+	uint64_t seed;
+	Importance_Sums *sums;
+} Importance_Blocks;
+
+static void Run_Importance_Block(uint64_t block, void *context)
+{
+	const Importance_Blocks *blocks = context;
+	uint64_t firstSample, samples;
+	Scheduler_Block_Range(block, blocks->numberOfSamples, &firstSample, &samples);
+	firstSample += blocks->firstSample;
+
+	const int dimensions = blocks->problem->box.dimensions;
+	const int groups = (dimensions + 1 + 3) / 4;
+	const int refined = blocks->proposal->refine != NULL;
+	const Philox_Key key = Philox_Make_Key(blocks->seed);
+	Importance_Sums *sums = &blocks->sums[block];
+
+	double sumW = 0, sumWW = 0;
+	for (uint64_t sample = firstSample; sample < firstSample + samples; sample++)
+	{
+		double u[IMPORTANCE_MAX_DIMENSIONS + 4];
+		for (int group = 0; group < groups; group++)
+		{
+			Philox_Block random = Philox4x32(Philox_Make_Counter(sample, IMPORTANCE_STREAM + group), key);
+			for (int word = 0; word < 4; word++)
+			{
+				u[group * 4 + word] = (random.v[word] + 0.5) * 0x1p-32;
+			}
+		}
+
+		double x[IMPORTANCE_MAX_DIMENSIONS];
+		double density = blocks->proposal->sample(blocks->state, u, x);
+		double weight = blocks->problem->integrand(x) / density;
+		sumW += weight;
+		sumWW += weight * weight;
+
+		if (refined)
+		{
+			for (int d = 0; d < dimensions; d++)
+			{
+				sums->binWeights[d][(int)(u[d + 1] * IMPORTANCE_GRID_BINS)] += weight * weight;
+			}
+		}
+	}
+
+	sums->sumW = sumW;
+	sums->sumWW = sumWW;
+}
+
+static double Cpu_Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+Importance_Report Importance_Run(const Importance_Problem *problem, const Importance_Proposal *proposal,
+                                 uint64_t number_of_samples, uint64_t seed)
+{
+	double cpuStart = Cpu_Seconds();
+	double start = omp_get_wtime();
+
+	Proposal_State *state = malloc(sizeof(Proposal_State));
+	proposal->prepare(state, problem);
+
+	double sumOfInverseVariances = 0, sumOfWeightedEstimates = 0, effectiveSamples = 0;
+	double sumW = 0, sumWW = 0;
+	for (int iteration = 0; iteration < IMPORTANCE_ITERATIONS; iteration++)
+	{
+		uint64_t firstSample = number_of_samples * iteration / IMPORTANCE_ITERATIONS;
+		uint64_t samples = number_of_samples * (iteration + 1) / IMPORTANCE_ITERATIONS - firstSample;
+		if (samples < 2)
+		{
+			continue;
+		}
+
+		uint64_t numberOfBlocks = Scheduler_Block_Count(samples);
+		Importance_Sums *sums = calloc(numberOfBlocks, sizeof(Importance_Sums));
+		Importance_Blocks blocks = { problem, proposal, state, firstSample, samples, seed, sums };
+		Scheduler_Run_Blocks(numberOfBlocks, Run_Importance_Block, &blocks, NULL);
+
+		// Combined in block order so the result doesn't depend on the threads
+		Importance_Sums total;
+		memset(&total, 0, sizeof(total));
+		for (uint64_t block = 0; block < numberOfBlocks; block++)
+		{
+			total.sumW += sums[block].sumW;
+			total.sumWW += sums[block].sumWW;
+			for (int d = 0; d < problem->box.dimensions && proposal->refine != NULL; d++)
+			{
+				for (int i = 0; i < IMPORTANCE_GRID_BINS; i++)
+				{
+					total.binWeights[d][i] += sums[block].binWeights[d][i];
+				}
+			}
+		}
+		free(sums);
+
+		sumW += total.sumW;
+		sumWW += total.sumWW;
+
+		double mean = total.sumW / samples;
+		double variance = (total.sumWW - total.sumW * mean) / (samples - 1) / samples;
+		// A proposal matching f exactly has no variance, rounding is all that is left
+		variance = fmax(variance, DBL_EPSILON * DBL_EPSILON * mean * mean + DBL_MIN);
+		sumOfInverseVariances += 1 / variance;
+		sumOfWeightedEstimates += mean / variance;
+		if (total.sumWW > 0)
+		{
+			effectiveSamples += total.sumW * total.sumW / total.sumWW;
+		}
+
+		if (proposal->refine != NULL && iteration < IMPORTANCE_ITERATIONS - 1)
+		{
+			proposal->refine(state, total.binWeights);
+		}
+	}
+	free(state);
+
+	Importance_Report report;
+	if (proposal->refine != NULL)
+	{
+		report.estimate = sumOfWeightedEstimates / sumOfInverseVariances;
+		report.standardError = sqrt(1 / sumOfInverseVariances);
+	}
+	else
+	{
+		// Weighting by the estimated variances would favour the iterations that
+		// happened to miss the peaks, so fixed proposals pool all their samples
+		double mean = sumW / number_of_samples;
+		report.estimate = mean;
+		report.standardError = sqrt(fmax(sumWW - sumW * mean, 0) / (number_of_samples - 1) / number_of_samples);
+	}
+	report.effectiveSamples = effectiveSamples;
+	report.samples = number_of_samples;
+	report.seconds = omp_get_wtime() - start;
+	report.cpuSeconds = Cpu_Seconds() - cpuStart;
+	return report;
+}
@@ -0,0 +1,110 @@
+#ifndef LAB1_IMPORTANCE_H
+#define LAB1_IMPORTANCE_H
+
+#include <stdint.h>
+
+#include "integrate.h"
+
+/*
+ * Importance sampling of integrals that are concentrated in a small part of
+ * their box, where uniform points mostly land on values close to zero.
+ *
+ * Point x is drawn from a proposal density q instead of uniformly and
+ * contributes the weight w = f(x) / q(x), the mean of which is the integral.
+ * The closer q follows f the less the weights vary. The proposals are
+ *
+ *   uniform   q = 1 / volume, plain Monte Carlo for reference
+ *   gaussian  product of Gaussians truncated to the box, with the mean and
+ *             width the problem supplies
+ *   mixture   weighted sum of such products, also supplied by the problem,
+ *             for integrands with more than one peak
+ *   vegas     product of piecewise constant densities on an adaptive grid of
+ *             IMPORTANCE_GRID_BINS bins per dimension, refined between
+ *             iterations towards the bins where f / q is largest
+ *
+ * The samples are run in IMPORTANCE_ITERATIONS iterations of equal size,
+ * each split into scheduler blocks. Sample i takes its uniforms from the
+ * Philox blocks with counter i of the streams IMPORTANCE_STREAM + 0, 1, ...:
+ * the first word picks the mixture component, the next ones the
+ * coordinates. Fixed proposals pool the samples of all iterations, adaptive
+ * ones combine the iteration estimates weighted by their inverse variance,
+ * so their poor early grids count for little.
+ *
+ * The quality of a proposal is its effective sample size (sum w)^2 / sum w^2,
+ * the number of equally weighted samples that would be worth as much as the
+ * weighted ones. Divided by the CPU time it took, it measures how much a
+ * proposal gains per unit of work, including the cost of evaluating q.
+ */
+
+#define IMPORTANCE_MAX_DIMENSIONS 8
+#define IMPORTANCE_MAX_COMPONENTS 4
+#define IMPORTANCE_GRID_BINS 64
+#define IMPORTANCE_ITERATIONS 10
+#define IMPORTANCE_STREAM UINT32_C(0x4000)
+
+// Product of Gaussians, one per dimension, truncated to the problem's box
+typedef struct Gaussian_Component {
+	double weight;
+	double mean[IMPORTANCE_MAX_DIMENSIONS];
+	double sigma[IMPORTANCE_MAX_DIMENSIONS];
+} Gaussian_Component;
+
+typedef struct Importance_Problem {
+	const char *name;
+	const char *description;
+	double (*integrand)(const double *x);
+	Integration_Box box;
+	double exactValue;
+	// Parameters of the gaussian proposal, its weight is ignored
+	Gaussian_Component gaussian;
+	// Components of the mixture proposal
+	int numberOfComponents;
+	Gaussian_Component components[IMPORTANCE_MAX_COMPONENTS];
+} Importance_Problem;
+
+typedef struct Proposal_State Proposal_State;
+
+typedef struct Importance_Proposal {
+	const char *name;
+	const char *description;
+	// Sets up the proposal for problem
+	void (*prepare)(Proposal_State *state, const Importance_Problem *problem);
+	// Maps the uniforms u (component first, then one per dimension) to a point x and returns q(x)
+	double (*sample)(const Proposal_State *state, const double *u, double *x);
+	// Adapts the proposal between iterations, NULL for fixed proposals. For every
+	// dimension d, bin_weights[d][i] is the sum of w^2 over the samples whose
+	// uniform for d fell in [i / IMPORTANCE_GRID_BINS, (i + 1) / IMPORTANCE_GRID_BINS)
+	void (*refine)(Proposal_State *state, double bin_weights[][IMPORTANCE_GRID_BINS]);
+} Importance_Proposal;
+
+typedef struct Importance_Report {
+	double estimate;
+	double standardError;
+	double effectiveSamples;
+	uint64_t samples;
+	// CPU time of every thread together, and the elapsed time
+	double cpuSeconds;
+	double seconds;
+} Importance_Report;
+
+// Returns the problem with the given name, or NULL if there is no such problem
+const Importance_Problem *Importance_Problem_Find(const char *name);
+
+// Writes the name and description of every problem
+void Importance_Problem_Print_All(void);
+
+// Returns the proposal with the given name, or NULL if there is no such proposal
+const Importance_Proposal *Importance_Proposal_Find(const char *name);
+
+// Returns the proposal at index, or NULL once index is past the last proposal
+const Importance_Proposal *Importance_Proposal_Get(int index);
+
+// Writes the name and description of every proposal
+void Importance_Proposal_Print_All(void);
+
+// Integrates problem with number_of_samples points drawn from proposal on the
+// OpenMP threads. The result does not depend on the number of threads
+Importance_Report Importance_Run(const Importance_Problem *problem, const Importance_Proposal *proposal,
+                                 uint64_t number_of_samples, uint64_t seed);
+
+#endif //LAB1_IMPORTANCE_H
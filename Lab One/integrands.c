@@ -0,0 +1,64 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "integrands.h"
+
+// Indicator of the unit ball, the volume of which is the integral over [-1, 1]^n
+#define DEFINE_BALL_INDICATOR(NAME, DIMENSIONS)                  \
+	static inline double NAME(const double *x)                   \
+	{                                                            \
+		double radius = 0;                                       \
+		for (int d = 0; d < (DIMENSIONS); d++)                   \
+		{                                                        \
+			radius += x[d] * x[d];                               \
+		}                                                        \
+		return radius < 1 ? 1.0 : 0.0;                           \
+	}
+
+DEFINE_BALL_INDICATOR(Circle_Indicator, 2)
+DEFINE_BALL_INDICATOR(Sphere_Indicator, 3)
+DEFINE_BALL_INDICATOR(Ball6_Indicator, 6)
+
+static inline double Gaussian5(const double *x)
+{
+	return exp(-(x[0] * x[0] + x[1] * x[1] + x[2] * x[2] + x[3] * x[3] + x[4] * x[4]));
+}
+
+DEFINE_MC_INTEGRATOR(Circle_Sum, 2, Circle_Indicator)
+DEFINE_MC_INTEGRATOR(Sphere_Sum, 3, Sphere_Indicator)
+DEFINE_MC_INTEGRATOR(Ball6_Sum, 6, Ball6_Indicator)
+DEFINE_MC_INTEGRATOR(Gaussian5_Sum, 5, Gaussian5)
+
+static const Integrand Integrands[] = {
+	{ "circle", "area of the unit circle over [-1, 1]^2 (pi)", Circle_Sum,
+	  { 2, { -1, -1 }, { 1, 1 } }, M_PI },
+	{ "sphere", "volume of the unit sphere over [-1, 1]^3 (4pi/3)", Sphere_Sum,
+	  { 3, { -1, -1, -1 }, { 1, 1, 1 } }, 4.1887902047863905 },
+	{ "ball6", "volume of the 6 dimensional unit ball over [-1, 1]^6 (pi^3/6)", Ball6_Sum,
+	  { 6, { -1, -1, -1, -1, -1, -1 }, { 1, 1, 1, 1, 1, 1 } }, 5.167712780049969 },
+	{ "gaussian5", "exp(-|x|^2) over [0, 1]^5 ((sqrt(pi)/2 erf(1))^5)", Gaussian5_Sum,
+	  { 5, { 0, 0, 0, 0, 0 }, { 1, 1, 1, 1, 1 } }, 0.2323227374343878 },
+};
+
+static const int Number_Of_Integrands = sizeof(Integrands) / sizeof(Integrands[0]);
+
+const Integrand *Integrand_Find(const char *name)
+{
+	for (int i = 0; i < Number_Of_Integrands; i++)
+	{
+		if (strcmp(Integrands[i].name, name) == 0)
+		{
+			return &Integrands[i];
+		}
+	}
+	return NULL;
+}
+
+void Integrand_Print_All(void)
+{
+	for (int i = 0; i < Number_Of_Integrands; i++)
+	{
+		printf("  %-12s%s\n", Integrands[i].name, Integrands[i].description);
+	}
+}
@@ -0,0 +1,21 @@
+#ifndef LAB1_INTEGRANDS_H
+#define LAB1_INTEGRANDS_H
+
+#include "integrate.h"
+
+// An integrand with a known value that the integration engine can be checked against
+typedef struct Integrand {
+	const char *name;
+	const char *description;
+	Integration_Sum_Fn sum;
+	Integration_Box box;
+	double exactValue;
+} Integrand;
+
+// Returns the integrand with the given name, or NULL if there is no such integrand
+const Integrand *Integrand_Find(const char *name);
+
+// Writes the name and description of every integrand
+void Integrand_Print_All(void);
+
+#endif //LAB1_INTEGRANDS_H
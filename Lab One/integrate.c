@@ -0,0 +1,81 @@
+#include <math.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include "integrate.h"
+#include "block_scheduler.h"
+#include "placement.h"
+
+typedef struct Integration_Blocks {
+	Integration_Sum_Fn sumFn;
+	const Integration_Box *box;
+	uint64_t numberOfSamples;
+	uint64_t seed;
+	Integration_Sums *sums;
+} Integration_Blocks;
+
+static void Run_Integration_Block(uint64_t block, void *context)
+{
+	Integration_Blocks *blocks = context;
+	uint64_t firstSample, samples;
+	Scheduler_Block_Range(block, blocks->numberOfSamples, &firstSample, &samples);
+
+	blocks->sumFn(firstSample, samples, blocks->seed, blocks->box, &blocks->sums[block]);
+}
+
+Integration_Result Integrate_Parallel(Integration_Sum_Fn sum_fn, const Integration_Box *box,
+                                      uint64_t number_of_samples, uint64_t seed, int deterministic)
+{
+	int numberOfThreads = omp_get_max_threads();
+	uint64_t numberOfParts = deterministic ? Scheduler_Block_Count(number_of_samples) : (uint64_t)numberOfThreads;
+	Integration_Sums *partialSums = calloc(numberOfParts, sizeof(Integration_Sums));
+
+	if (deterministic)
+	{
+		Integration_Blocks blocks = { sum_fn, box, number_of_samples, seed, partialSums };
+		Scheduler_Run_Blocks(numberOfParts, Run_Integration_Block, &blocks, NULL);
+	}
+	else
+	{
+		//Splits the workload by the number of threads, each thread skipping ahead to its slice
+		#pragma omp parallel for num_threads(numberOfThreads)
+		for (int i = 0; i < numberOfThreads; i++)
+		{
+			Placement_Pin_Thread(omp_get_thread_num());
+			uint64_t firstSample = number_of_samples * i / numberOfThreads;
+			uint64_t lastSample = number_of_samples * (i + 1) / numberOfThreads;
+
+			Integration_Sums threadSums = { 0, 0, 0 };
+			sum_fn(firstSample, lastSample - firstSample, seed, box, &threadSums);
+			partialSums[i] = threadSums;
+		}
+	}
+
+	// Combined in thread (or block) order rather than with a reduction clause
+	// so the floating point sum doesn't depend on which thread finishes first
+	Integration_Sums total = { 0, 0, 0 };
+	for (uint64_t i = 0; i < numberOfParts; i++)
+	{
+		total.sum += partialSums[i].sum;
+		total.sumOfSquares += partialSums[i].sumOfSquares;
+		total.samples += partialSums[i].samples;
+	}
+	free(partialSums);
+
+	double volume = 1;
+	for (int d = 0; d < box->dimensions; d++)
+	{
+		volume *= box->upper[d] - box->lower[d];
+	}
+
+	double mean = total.sum / total.samples;
+	double variance = total.samples > 1
+		? (total.sumOfSquares - total.sum * mean) / (total.samples - 1)
+		: 0;
+
+	Integration_Result result;
+	result.estimate = volume * mean;
+	result.standardError = volume * sqrt(fmax(variance, 0) / total.samples);
+	result.samples = total.samples;
+	return result;
+}
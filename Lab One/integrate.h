@@ -0,0 +1,125 @@
+#ifndef LAB1_INTEGRATE_H
+#define LAB1_INTEGRATE_H
+
+#include <stdint.h>
+
+#include "rng.h"
+
+/*
+ * Monte Carlo integration of f over an N dimensional box, built on the same
+ * Philox sequence and per-thread partitioning as the pi estimator.
+ *
+ * An integrator is generated for one integrand and one dimension with
+ *
+ *     static inline double My_Integrand(const double *x) { ... }
+ *     DEFINE_MC_INTEGRATOR(My_Sum, 3, My_Integrand)
+ *
+ * which defines My_Sum as an Integration_Sum_Fn. Because the dimension and
+ * the integrand are known when the macro is expanded, the integrand is
+ * inlined and the loops over the coordinates are fully unrolled. The kernel
+ * is also cloned for AVX-512, AVX2 and baseline x86-64 and picked at load
+ * time, so the point generation and integrand loops get vectorised for the
+ * widest unit the CPU has.
+ *
+ * Sample i draws its coordinates from the Philox blocks with counter i of
+ * the streams MC_INTEGRATION_STREAM + 0, 1, ... (four coordinates per
+ * block), so every sample can be generated independently of the others.
+ */
+
+#define MC_MAX_DIMENSIONS 16
+#define MC_INTEGRATION_STREAM UINT32_C(0x1000)
+
+// Samples generated and evaluated together by the generated kernels
+#define MC_CHUNK_SIZE 64
+
+#define MC_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+
+typedef struct Integration_Box {
+	int dimensions;
+	double lower[MC_MAX_DIMENSIONS];
+	double upper[MC_MAX_DIMENSIONS];
+} Integration_Box;
+
+typedef struct Integration_Sums {
+	double sum;
+	double sumOfSquares;
+	uint64_t samples;
+} Integration_Sums;
+
+typedef struct Integration_Result {
+	double estimate;
+	double standardError;
+	uint64_t samples;
+} Integration_Result;
+
+// Adds f over the samples [first_sample, first_sample + number_of_samples) to sums
+typedef void (*Integration_Sum_Fn)(uint64_t first_sample, uint64_t number_of_samples, uint64_t seed,
+                                   const Integration_Box *box, Integration_Sums *sums);
+
+// Splits the samples over the OpenMP threads like Calculate_Pi_Parallel and
+// returns volume * mean(f) with its standard error. With deterministic set
+// the samples are run as scheduler blocks instead, which makes the result
+// independent of the number of threads
+Integration_Result Integrate_Parallel(Integration_Sum_Fn sum_fn, const Integration_Box *box,
+                                      uint64_t number_of_samples, uint64_t seed, int deterministic);
+
+#define DEFINE_MC_INTEGRATOR(NAME, DIMENSIONS, INTEGRAND)                                                 \
+	MC_TARGET_CLONES                                                                                      \
+	static void NAME(uint64_t first_sample, uint64_t number_of_samples, uint64_t seed,                    \
+	                 const Integration_Box *box, Integration_Sums *sums)                                  \
+	{                                                                                                     \
+		_Static_assert((DIMENSIONS) > 0 && (DIMENSIONS) <= MC_MAX_DIMENSIONS, "Unsupported dimension");  \
+		enum { Groups = ((DIMENSIONS) + 3) / 4 };                                                         \
+                                                                                                          \
+		const Philox_Key key = Philox_Make_Key(seed);                                                     \
+		double scale[DIMENSIONS], offset[DIMENSIONS];                                                     \
+		for (int d = 0; d < (DIMENSIONS); d++)                                                            \
+		{                                                                                                 \
+			/* Maps a 32 bit word w to the centre of its cell, lower + (w + 0.5) / 2^32 * width */        \
+			scale[d] = (box->upper[d] - box->lower[d]) * 0x1p-32;                                         \
+			offset[d] = box->lower[d] + 0.5 * scale[d];                                                   \
+		}                                                                                                 \
+                                                                                                          \
+		double sum = 0, sumOfSquares = 0;                                                                 \
+		const uint64_t endSample = first_sample + number_of_samples;                                      \
+		for (uint64_t sample = first_sample; sample < endSample; sample += MC_CHUNK_SIZE)                 \
+		{                                                                                                 \
+			const int chunk = endSample - sample < MC_CHUNK_SIZE ? (int)(endSample - sample) : MC_CHUNK_SIZE; \
+			double point[MC_CHUNK_SIZE][DIMENSIONS];                                                      \
+			double value[MC_CHUNK_SIZE];                                                                  \
+                                                                                                          \
+			for (int j = 0; j < chunk; j++)                                                               \
+			{                                                                                             \
+				for (int group = 0; group < Groups; group++)                                              \
+				{                                                                                         \
+					Philox_Block block = Philox4x32(                                                      \
+						Philox_Make_Counter(sample + j, MC_INTEGRATION_STREAM + group), key);             \
+					for (int word = 0; word < 4 && group * 4 + word < (DIMENSIONS); word++)               \
+					{                                                                                     \
+						const int d = group * 4 + word;                                                   \
+						point[j][d] = offset[d] + scale[d] * block.v[word];                               \
+					}                                                                                     \
+				}                                                                                         \
+			}                                                                                             \
+                                                                                                          \
+			for (int j = 0; j < chunk; j++)                                                               \
+			{                                                                                             \
+				value[j] = INTEGRAND(point[j]);                                                           \
+			}                                                                                             \
+                                                                                                          \
+			double chunkSum = 0, chunkSumOfSquares = 0;                                                   \
+			for (int j = 0; j < chunk; j++)                                                               \
+			{                                                                                             \
+				chunkSum += value[j];                                                                     \
+				chunkSumOfSquares += value[j] * value[j];                                                 \
+			}                                                                                             \
+			sum += chunkSum;                                                                              \
+			sumOfSquares += chunkSumOfSquares;                                                            \
+		}                                                                                                 \
+                                                                                                          \
+		sums->sum += sum;                                                                                 \
+		sums->sumOfSquares += sumOfSquares;                                                               \
+		sums->samples += number_of_samples;                                                               \
+	}
+
+#endif //LAB1_INTEGRATE_H
@@ -1,9 +1,29 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <signal.h>
+#include <string.h>
 #include <omp.h>
 #include <time.h>
 #include <sys/time.h>
 
+#include "circle_kernels.h"
+#include "sobol.h"
+#include "statistics.h"
+#include "integrands.h"
+#include "checkpoint.h"
+#include "estimators.h"
+#include "block_scheduler.h"
+#include "toss_generators.h"
+#include "fused_estimators.h"
+#include "telemetry.h"
+#include "shared_run.h"
+#include "placement.h"
+#include "importance.h"
+
 /*
  * This Project References an article on "OpenMP: Monte Carlo method for Pi"
  * Found at: http://jakascorner.com/blog/2016/05/omp-monte-carlo-pi.html
@@ -12,78 +32,1279 @@
  * the parallel values provided by OpenMP
  */
 
-// Returns a random value between -1 and 1
-double getRand(unsigned int *seed)
+// Kernel used by Count_Number_Of_Samples_In_Circle, picked from the CPU at startup
+static const Circle_Kernel *Active_Kernel;
+
+// Counts the tosses [first_toss, first_toss + number_of_tosses) of the global
+// sequence for this seed that land in the circle
+uint64_t Count_Number_Of_Samples_In_Circle(uint64_t first_toss, uint64_t number_of_tosses, uint64_t seed)
+{
+	return Active_Kernel->count(first_toss, number_of_tosses, seed);
+}
+
+long double Calculate_Pi_Sequential(long long number_of_tosses, uint64_t seed) {
+	//Calls Count_Number_Of_Samples_In_Circle without dividing the workload
+	uint64_t count = Count_Number_Of_Samples_In_Circle(0, (uint64_t)number_of_tosses, seed);
+
+	return (long double)count / number_of_tosses * 4;
+}
+
+// Set by --deterministic: the floating point parallel drivers split their
+// work into fixed logical blocks and combine the per block results in block
+// order, so they return the same bits for any number of threads. The pi
+// driver always runs in blocks since its integer counts can't depend on order
+static int Deterministic_Blocks = 0;
+
+typedef struct Pi_Blocks {
+	uint64_t numberOfTosses;
+	uint64_t seed;
+	uint64_t *samplesInCircle;
+} Pi_Blocks;
+
+static void Run_Pi_Block(uint64_t block, void *context)
+{
+	Pi_Blocks *blocks = context;
+	uint64_t firstToss, tosses;
+	Scheduler_Block_Range(block, blocks->numberOfTosses, &firstToss, &tosses);
+
+	blocks->samplesInCircle[block] = Count_Number_Of_Samples_In_Circle(firstToss, tosses, blocks->seed);
+	Telemetry_Add(omp_get_thread_num(), tosses, blocks->samplesInCircle[block]);
+}
+
+// Splits the tosses into fixed size blocks that are served to the threads by
+// the work stealing scheduler, so a slow core just runs fewer blocks. The
+// last block takes the remainder, so every toss is counted. If stats is not
+// NULL it receives the blocks every thread completed
+long double Calculate_Pi_Parallel_Blocks(long long number_of_tosses, uint64_t seed, Scheduler_Stats *stats)
+{
+	uint64_t numberOfBlocks = Scheduler_Block_Count((uint64_t)number_of_tosses);
+
+	Pi_Blocks blocks = { (uint64_t)number_of_tosses, seed, calloc(numberOfBlocks, sizeof(uint64_t)) };
+	Scheduler_Run_Blocks(numberOfBlocks, Run_Pi_Block, &blocks, stats);
+
+	uint64_t numberOfSamplesInCircle = 0;
+	for (uint64_t block = 0; block < numberOfBlocks; block++)
+	{
+		numberOfSamplesInCircle += blocks.samplesInCircle[block];
+	}
+	free(blocks.samplesInCircle);
+
+	return (long double)numberOfSamplesInCircle / number_of_tosses * 4;
+}
+
+// Each block jumps straight to its slice of the global sequence, so the
+// result is the same as the sequential one for any number of threads
+long double Calculate_Pi_Parallel(long long number_of_tosses, uint64_t seed)
+{
+	return Calculate_Pi_Parallel_Blocks(number_of_tosses, seed, NULL);
+}
+
+// Largest radius for which R^2 and every row's square fit in a signed 64 bit integer
+static const uint64_t Lattice_Max_Radius = UINT64_C(3037000499);
+
+typedef struct Lattice_Blocks {
+	uint64_t radius;
+	uint64_t *rowSums;
+} Lattice_Blocks;
+
+static inline double Bits_To_Double(uint64_t bits)
+{
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static inline uint64_t Double_To_Bits(double value)
 {
-	return (double)rand_r(seed) * 2 / (double)(RAND_MAX)-1;
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
 }
 
-int Count_Number_Of_Samples_In_Circle(long number_of_tosses, int seed)
+// Sums floor(sqrt(R^2 - y^2)) over the rows [first_row, first_row + number_of_rows).
+// The double square root is within one of the exact one for R^2 < 2^63, so a
+// single integer correction each way makes it exact. The loop has no
+// branches so the compiler can vectorise it across rows; the conversions
+// between 64 bit integers and doubles are done by placing the integer in the
+// mantissa of 2^52 or 2^84, since only AVX-512DQ has instructions for them.
+// Rows and roots are below 2^32, so every square is a 32 x 32 bit multiply
+__attribute__((target_clones("avx512f", "avx2", "default")))
+static uint64_t Lattice_Row_Sum(uint64_t radius, uint64_t first_row, uint64_t number_of_rows)
 {
-	double x, y;
-	int numberOfSamplesInCircle = 0;
+	uint64_t radiusSquared = radius * radius;
+	uint64_t sum = 0;
 
-	for (int i = 0; i < number_of_tosses; i++)
+	for (uint64_t row = first_row; row < first_row + number_of_rows; row++)
 	{
-		x = getRand(&seed);
-		y = getRand(&seed);
-		if (x * x + y * y < 1) {
-			numberOfSamplesInCircle++;
+		uint32_t y = (uint32_t)row;
+		uint64_t remaining = radiusSquared - (uint64_t)y * y;
+
+		double high = Bits_To_Double(remaining >> 32 | UINT64_C(0x4530000000000000)) - 0x1p84;
+		double low = Bits_To_Double((remaining & UINT32_MAX) | UINT64_C(0x4330000000000000)) - 0x1p52;
+		uint32_t x = (uint32_t)Double_To_Bits(sqrt(high + low) + 0x1p52);
+
+		x -= (uint64_t)x * x > remaining;
+		x += (uint64_t)(x + 1) * (x + 1) <= remaining;
+		sum += x;
+	}
+
+	return sum;
+}
+
+static void Run_Lattice_Block(uint64_t block, void *context)
+{
+	Lattice_Blocks *blocks = context;
+	uint64_t firstRow, rows;
+	Scheduler_Block_Range(block, blocks->radius, &firstRow, &rows);
+
+	// Rows 1 to R, row 0 is counted separately
+	blocks->rowSums[block] = Lattice_Row_Sum(blocks->radius, firstRow + 1, rows);
+}
+
+// Deterministic reference: counts the integer points (x, y) with
+// x^2 + y^2 <= R^2 (the Gauss circle problem) and divides by R^2. The error
+// shrinks like R^(-4/3) or better, so R = 10^9 gives pi to about 12 digits.
+// By symmetry only the rows y = 1..R of one quadrant are summed, in parallel
+// blocks whose 64 bit row sums are reduced into a 128 bit total
+long double Calculate_Pi_Lattice(uint64_t radius, unsigned __int128 *lattice_points)
+{
+	uint64_t numberOfBlocks = Scheduler_Block_Count(radius);
+
+	Lattice_Blocks blocks = { radius, calloc(numberOfBlocks, sizeof(uint64_t)) };
+	Scheduler_Run_Blocks(numberOfBlocks, Run_Lattice_Block, &blocks, NULL);
+
+	unsigned __int128 quadrantPoints = 0;
+	for (uint64_t block = 0; block < numberOfBlocks; block++)
+	{
+		quadrantPoints += blocks.rowSums[block];
+	}
+	free(blocks.rowSums);
+
+	// Four open quadrants, the four half axes and the origin
+	*lattice_points = 4 * quadrantPoints + 4 * (unsigned __int128)radius + 1;
+
+	return (long double)*lattice_points / ((long double)radius * radius);
+}
+
+// Counts blocks of a run shared with other processes until every block is
+// taken, then waits for the other processes and stores the merged estimate
+// in pi. Returns 0, or -1 with errno set if another process died first
+int Calculate_Pi_Shared(Shared_Run *run, const char *name, int slot, long double *pi)
+{
+	double start = omp_get_wtime();
+
+	#pragma omp parallel num_threads(omp_get_max_threads())
+	{
+		Placement_Pin_Thread(omp_get_thread_num());
+
+		uint64_t firstToss, tosses;
+		while (Shared_Run_Next_Block(run, &firstToss, &tosses))
+		{
+			uint64_t hits = Count_Number_Of_Samples_In_Circle(firstToss, tosses, run->seed);
+			Shared_Run_Add(run, slot, tosses, hits);
+			Telemetry_Add(omp_get_thread_num(), tosses, hits);
 		}
 	}
 
-	return numberOfSamplesInCircle;
+	if (Shared_Run_Finish(run, name, slot, omp_get_wtime() - start) != 0)
+	{
+		return -1;
+	}
+
+	*pi = (long double)atomic_load(&run->mergedSamplesInCircle) / run->totalTosses * 4;
+	return 0;
 }
 
-long double Calculate_Pi_Sequential(long long number_of_tosses) {
-	unsigned int seed = (unsigned int)time(NULL);
+typedef struct Estimator_Blocks {
+	const Pi_Estimator *estimator;
+	uint64_t numberOfBatches;
+	uint64_t seed;
+	Estimator_Sums *sums;
+} Estimator_Blocks;
 
-	//Calls Count_Number_Of_Samples_In_Circle without dividing the workload
-	int count = Count_Number_Of_Samples_In_Circle(number_of_tosses, seed);
+static void Run_Estimator_Block(uint64_t block, void *context)
+{
+	Estimator_Blocks *blocks = context;
+	uint64_t firstBatch, batches;
+	Scheduler_Block_Range(block, blocks->numberOfBatches * ESTIMATOR_BATCH_SIZE, &firstBatch, &batches);
 
-	return (double)count / number_of_tosses * 4;
+	Estimator_Run_Batches(blocks->estimator, firstBatch / ESTIMATOR_BATCH_SIZE, batches / ESTIMATOR_BATCH_SIZE,
+						  blocks->seed, &blocks->sums[block]);
 }
 
-long double Calculate_Pi_Parallel(long long number_of_tosses)
+// Runs a variance reduced estimator with the per-thread split of
+// Calculate_Pi_Parallel, over whole batches of ESTIMATOR_BATCH_SIZE tosses
+Estimator_Report Calculate_Pi_Estimator_Parallel(const Pi_Estimator *estimator, long long number_of_tosses, uint64_t seed)
 {
 	int numberOfThreads = omp_get_max_threads();
-	int workloadPerThread = number_of_tosses / numberOfThreads;
+	uint64_t numberOfBatches = (uint64_t)number_of_tosses / ESTIMATOR_BATCH_SIZE;
 
-	int numberOfSamplesInCircle = 0;
+	if (Deterministic_Blocks)
+	{
+		// Blocks hold a whole number of batches since SCHEDULER_BLOCK_SIZE is a multiple of ESTIMATOR_BATCH_SIZE
+		uint64_t numberOfBlocks = Scheduler_Block_Count(numberOfBatches * ESTIMATOR_BATCH_SIZE);
+		Estimator_Blocks blocks = { estimator, numberOfBatches, seed, calloc(numberOfBlocks, sizeof(Estimator_Sums)) };
+		Scheduler_Run_Blocks(numberOfBlocks, Run_Estimator_Block, &blocks, NULL);
+
+		Estimator_Sums total;
+		memset(&total, 0, sizeof(total));
+		for (uint64_t block = 0; block < numberOfBlocks; block++)
+		{
+			Estimator_Sums_Merge(&total, &blocks.sums[block]);
+		}
+		free(blocks.sums);
+
+		return Estimator_Finish(estimator, &total);
+	}
+
+	Estimator_Sums *partialSums = calloc((size_t)numberOfThreads, sizeof(Estimator_Sums));
 
-	//Splits the workload by the number of threads
 	#pragma omp parallel for num_threads(numberOfThreads)
 	for (int i = 0; i < numberOfThreads; i++)
 	{
-		unsigned int seed = (unsigned int)time(NULL) + (unsigned int)omp_get_thread_num();
+		Placement_Pin_Thread(omp_get_thread_num());
+		uint64_t firstBatch = numberOfBatches * i / numberOfThreads;
+		uint64_t lastBatch = numberOfBatches * (i + 1) / numberOfThreads;
+
+		Estimator_Run_Batches(estimator, firstBatch, lastBatch - firstBatch, seed, &partialSums[i]);
+	}
+
+	// Merged in thread order so the floating point sums are reproducible
+	Estimator_Sums total;
+	memset(&total, 0, sizeof(total));
+	for (int i = 0; i < numberOfThreads; i++)
+	{
+		Estimator_Sums_Merge(&total, &partialSums[i]);
+	}
+	free(partialSums);
+
+	return Estimator_Finish(estimator, &total);
+}
+
+typedef struct Fused_Blocks {
+	const Fused_Kernel *kernel;
+	uint64_t numberOfVectors;
+	uint64_t seed;
+	Fused_Counts *counts;
+} Fused_Blocks;
+
+static void Run_Fused_Block(uint64_t block, void *context)
+{
+	Fused_Blocks *blocks = context;
+	uint64_t firstVector, vectors;
+	Scheduler_Block_Range(block, blocks->numberOfVectors, &firstVector, &vectors);
+
+	blocks->kernel->count(firstVector, vectors, blocks->seed, &blocks->counts[block]);
+}
+
+// Draws number_of_vectors random vectors once and counts every fused
+// estimator on them, split into scheduler blocks like Calculate_Pi_Parallel.
+// The counts are integers, so they don't depend on the number of threads
+Fused_Counts Calculate_Fused_Parallel(const Fused_Kernel *kernel, long long number_of_vectors, uint64_t seed)
+{
+	uint64_t numberOfBlocks = Scheduler_Block_Count((uint64_t)number_of_vectors);
+
+	Fused_Blocks blocks = { kernel, (uint64_t)number_of_vectors, seed, calloc(numberOfBlocks, sizeof(Fused_Counts)) };
+	Scheduler_Run_Blocks(numberOfBlocks, Run_Fused_Block, &blocks, NULL);
+
+	Fused_Counts total;
+	memset(&total, 0, sizeof(total));
+	for (uint64_t block = 0; block < numberOfBlocks; block++)
+	{
+		Fused_Counts_Merge(&total, &blocks.counts[block]);
+	}
+	free(blocks.counts);
+
+	return total;
+}
+
+// Tosses each worker claims at a time in Calculate_Pi_Adaptive
+static const uint64_t Adaptive_Batch_Size = UINT64_C(1) << 20;
+
+// Keeps drawing batches of tosses until the confidence interval of the
+// estimate is no wider than ±target_error, or max_tosses have been drawn.
+// Workers claim batches from a shared counter and merge their hit counts
+// with atomics, so nothing ever waits on a lock. A toss is a Bernoulli
+// trial, so the hit and toss counts are all that is needed for the variance
+long double Calculate_Pi_Adaptive(long double target_error, double confidence, uint64_t max_tosses, uint64_t seed,
+                                  uint64_t *tosses_used, long double *half_width)
+{
+	const double z = Normal_Critical_Value(confidence);
+
+	uint64_t nextBatch = 0;
+	uint64_t numberOfTosses = 0;
+	uint64_t numberOfSamplesInCircle = 0;
+	int targetReached = 0;
+
+	#pragma omp parallel num_threads(omp_get_max_threads())
+	{
+		Placement_Pin_Thread(omp_get_thread_num());
+
+		for (;;)
+		{
+			int stop;
+			#pragma omp atomic read
+			stop = targetReached;
+
+			uint64_t batch;
+			#pragma omp atomic capture
+			batch = nextBatch++;
+
+			uint64_t firstToss = batch * Adaptive_Batch_Size;
+			if (stop || firstToss >= max_tosses)
+			{
+				break;
+			}
+
+			uint64_t tosses = max_tosses - firstToss < Adaptive_Batch_Size ? max_tosses - firstToss : Adaptive_Batch_Size;
+			uint64_t hits = Count_Number_Of_Samples_In_Circle(firstToss, tosses, seed);
+			Telemetry_Add(omp_get_thread_num(), tosses, hits);
+
+			// The two counters are merged separately, so the snapshot can be off
+			// by the batches other threads are merging right now. That only moves
+			// the stopping point by a batch, the final estimate is taken after
+			// every worker is done
+			uint64_t mergedHits, mergedTosses;
+			#pragma omp atomic capture
+			{ numberOfSamplesInCircle += hits; mergedHits = numberOfSamplesInCircle; }
+			#pragma omp atomic capture
+			{ numberOfTosses += tosses; mergedTosses = numberOfTosses; }
+
+			double hitRate = (double)mergedHits / mergedTosses;
+			double halfWidth = z * 4 * sqrt(hitRate * (1 - hitRate) / mergedTosses);
+			if (halfWidth <= target_error)
+			{
+				#pragma omp atomic write
+				targetReached = 1;
+			}
+		}
+	}
+
+	long double hitRate = (long double)numberOfSamplesInCircle / numberOfTosses;
+	*tosses_used = numberOfTosses;
+	*half_width = z * 4 * sqrtl(hitRate * (1 - hitRate) / numberOfTosses);
+
+	return hitRate * 4;
+}
+
+// Estimates pi from scrambles independently scrambled Sobol point sets of
+// number_of_tosses / scrambles points each. The spread between the scrambles
+// gives the standard error of the returned mean
+long double Calculate_Pi_Qmc_Parallel(long long number_of_tosses, uint64_t seed, int scrambles, long double *standard_error)
+{
+	int numberOfThreads = omp_get_max_threads();
+	uint64_t pointsPerScramble = (uint64_t)number_of_tosses / scrambles;
+
+	long double sum = 0, sumOfSquares = 0;
+
+	for (int scramble = 0; scramble < scrambles; scramble++)
+	{
+		Sobol_Scramble sobolScramble = Sobol_Make_Scramble(seed, (uint32_t)scramble);
+		uint64_t numberOfSamplesInCircle = 0;
+
+		//Every thread takes a contiguous slice of the point set and skips ahead to it
+		#pragma omp parallel for num_threads(numberOfThreads) reduction(+:numberOfSamplesInCircle)
+		for (int i = 0; i < numberOfThreads; i++)
+		{
+			Placement_Pin_Thread(omp_get_thread_num());
+			uint64_t firstPoint = pointsPerScramble * i / numberOfThreads;
+			uint64_t lastPoint = pointsPerScramble * (i + 1) / numberOfThreads;
 
-		//Calls Count_Number_Of_Samples_In_Circle one per thread with the divided workload
-		numberOfSamplesInCircle += Count_Number_Of_Samples_In_Circle(workloadPerThread, seed);
+			numberOfSamplesInCircle += Count_Sobol_Samples_In_Circle(firstPoint, lastPoint - firstPoint, sobolScramble);
+		}
+
+		long double estimate = (long double)numberOfSamplesInCircle / pointsPerScramble * 4;
+		sum += estimate;
+		sumOfSquares += estimate * estimate;
 	}
 
-	return (double)numberOfSamplesInCircle / number_of_tosses * 4;
+	long double mean = sum / scrambles;
+	long double variance = scrambles > 1 ? (sumOfSquares - scrambles * mean * mean) / (scrambles - 1) : 0;
+	*standard_error = sqrtl(fmaxl(variance, 0) / scrambles);
+
+	return mean;
 }
 
-int main() {
+static double Elapsed_Seconds(const struct timeval *start, const struct timeval *end)
+{
+	return end->tv_sec - start->tv_sec + (double)(end->tv_usec - start->tv_usec) / 1000000;
+}
+
+// Set from SIGTERM/SIGINT so a preempted long run can checkpoint and exit cleanly. The long run
+// checks it before every batch, so a stop takes about one batch per thread rather than an epoch
+static volatile sig_atomic_t Stop_Requested = 0;
+
+static void Request_Stop(int signal_number)
+{
+	(void)signal_number;
+	Stop_Requested = 1;
+}
+
+// Tosses each thread claims at a time within a long run epoch
+static const uint64_t Long_Run_Batch_Size = UINT64_C(1) << 22;
+
+// Continues the run described by checkpoint until all its tosses are counted.
+// The tosses are drawn in epochs sized to take about checkpoint_interval
+// seconds; after every epoch the checkpoint is updated and written to
+// checkpoint_path. On a stop request the batches not yet started are skipped
+// and the checkpoint records the batches completed up to the first skipped one.
+// Returns 0 once the run is complete, 1 if it was stopped by a signal and -1 if
+// the checkpoint couldn't be written
+int Calculate_Pi_Long_Run(Pi_Checkpoint *checkpoint, const char *checkpoint_path, double checkpoint_interval)
+{
+	struct timeval start, end;
+	int numberOfThreads = omp_get_max_threads();
+
+	// The first epoch is a guess, the later ones are sized from the measured rate
+	uint64_t epochTosses = Long_Run_Batch_Size * numberOfThreads;
+
+	while (checkpoint->completedTosses < checkpoint->totalTosses && !Stop_Requested)
+	{
+		uint64_t firstToss = checkpoint->completedTosses;
+		uint64_t remainingTosses = checkpoint->totalTosses - firstToss;
+		if (epochTosses > remainingTosses)
+		{
+			epochTosses = remainingTosses;
+		}
+		uint64_t lastToss = firstToss + epochTosses;
+		uint64_t batches = (epochTosses + Long_Run_Batch_Size - 1) / Long_Run_Batch_Size;
+
+		// Hits of every batch, and whether it ran, so a stopped epoch can keep its completed prefix
+		uint64_t *batchHits = malloc(batches * sizeof(uint64_t));
+		unsigned char *batchDone = calloc(batches, 1);
+		if (batchHits == NULL || batchDone == NULL)
+		{
+			free(batchHits);
+			free(batchDone);
+			return -1;
+		}
+
+		gettimeofday(&start, NULL);
+		#pragma omp parallel for num_threads(numberOfThreads) schedule(dynamic)
+		for (uint64_t batch = 0; batch < batches; batch++)
+		{
+			if (Stop_Requested)
+			{
+				continue;
+			}
+			// Cheap once the thread is pinned, a dynamic schedule has no per thread prologue
+			Placement_Pin_Thread(omp_get_thread_num());
+			uint64_t batchStart = firstToss + batch * Long_Run_Batch_Size;
+			uint64_t batchTosses = lastToss - batchStart < Long_Run_Batch_Size ? lastToss - batchStart : Long_Run_Batch_Size;
+
+			batchHits[batch] = Count_Number_Of_Samples_In_Circle(batchStart, batchTosses, checkpoint->seed);
+			batchDone[batch] = 1;
+			Telemetry_Add(omp_get_thread_num(), batchTosses, batchHits[batch]);
+		}
+		gettimeofday(&end, NULL);
+
+		// Batches finished after a skipped one are drawn again when the run resumes
+		uint64_t completedBatches = 0, numberOfSamplesInCircle = 0;
+		while (completedBatches < batches && batchDone[completedBatches])
+		{
+			numberOfSamplesInCircle += batchHits[completedBatches++];
+		}
+		free(batchHits);
+		free(batchDone);
+
+		uint64_t completedToss = firstToss + completedBatches * Long_Run_Batch_Size;
+		checkpoint->completedTosses = completedToss < lastToss ? completedToss : lastToss;
+		checkpoint->samplesInCircle += numberOfSamplesInCircle;
+		if (Checkpoint_Write(checkpoint_path, checkpoint) != 0)
+		{
+			return -1;
+		}
+		if (completedBatches < batches)
+		{
+			break;
+		}
+
+		printf("%6.2f%% done, π ≈ %.10Lf\n", 100.0 * checkpoint->completedTosses / checkpoint->totalTosses,
+			   (long double)checkpoint->samplesInCircle / checkpoint->completedTosses * 4);
+		fflush(stdout);
+
+		double seconds = Elapsed_Seconds(&start, &end);
+		double tossesPerSecond = epochTosses / (seconds > 1e-3 ? seconds : 1e-3);
+		epochTosses = (uint64_t)(tossesPerSecond * checkpoint_interval);
+		if (epochTosses < Long_Run_Batch_Size * numberOfThreads)
+		{
+			epochTosses = Long_Run_Batch_Size * numberOfThreads;
+		}
+	}
+
+	return checkpoint->completedTosses == checkpoint->totalTosses ? 0 : 1;
+}
+
+// Writes value in decimal to text, which must hold at least 40 characters
+static const char *Format_U128(unsigned __int128 value, char *text)
+{
+	char *digit = text + 39;
+	*digit = '\0';
+	do
+	{
+		*--digit = (char)('0' + (int)(value % 10));
+		value /= 10;
+	} while (value != 0);
+	return digit;
+}
+
+// Parses a positive count, also accepting scientific notation such as 1e12
+static long long Parse_Count(const char *text)
+{
+	char *end;
+	long double value = strtold(text, &end);
+	if (end == text || *end != '\0' || value < 1 || value >= 0x1p63L || value != (long long)value)
+	{
+		return -1;
+	}
+	return (long long)value;
+}
+
+// Runs the named estimator, or all of them with "all", and compares the
+// variance and time of each with plain hit or miss sampling
+static int Compare_Estimators(const char *name, long long number_of_tosses, uint64_t seed)
+{
+	struct timeval start, end;
+	int runAll = strcmp(name, "all") == 0;
+
+	if (!runAll && Estimator_Find(name) == NULL)
+	{
+		fprintf(stderr, "Unknown estimator \"%s\"\n", name);
+		return 1;
+	}
+	if (number_of_tosses < 2 * ESTIMATOR_BATCH_SIZE)
+	{
+		fprintf(stderr, "The estimators need at least %d tosses\n", 2 * ESTIMATOR_BATCH_SIZE);
+		return 1;
+	}
+
+	printf("%-12s %14s %14s %14s %10s %12s %10s\n", "estimator", "π", "std error", "var/toss", "time (s)", "Mtoss/s", "gain");
+
+	double referenceCost = 0;
+	const Pi_Estimator *estimator;
+	for (int i = 0; (estimator = Estimator_Get(i)) != NULL; i++)
+	{
+		if (!runAll && strcmp(estimator->name, name) != 0)
+		{
+			continue;
+		}
+
+		gettimeofday(&start, NULL);
+		Estimator_Report report = Calculate_Pi_Estimator_Parallel(estimator, number_of_tosses, seed);
+		gettimeofday(&end, NULL);
+		double seconds = Elapsed_Seconds(&start, &end);
+
+		// Work normalised variance: how much faster the estimator reaches a given error
+		double cost = report.variancePerSample * seconds / report.samples;
+		if (i == 0)
+		{
+			referenceCost = cost;
+		}
+
+		printf("%-12s %14.10f %14.10f %14.6f %10.4f %12.1f", estimator->name, report.estimate, report.standardError,
+			   report.variancePerSample, seconds, report.samples / seconds / 1e6);
+		if (referenceCost > 0)
+		{
+			printf(" %9.1fx", referenceCost / cost);
+		}
+		printf("\n");
+	}
+
+	return 0;
+}
+
+// Integrates problem with every proposal (or only the named one) and compares
+// the effective samples each one gains per CPU second
+static int Compare_Proposals(const Importance_Problem *problem, const char *name, long long number_of_samples, uint64_t seed)
+{
+	if (name != NULL && Importance_Proposal_Find(name) == NULL)
+	{
+		fprintf(stderr, "Unknown proposal \"%s\"\n", name);
+		return 1;
+	}
+	if (number_of_samples < 2 * IMPORTANCE_ITERATIONS)
+	{
+		fprintf(stderr, "Importance sampling needs at least %d samples\n", 2 * IMPORTANCE_ITERATIONS);
+		return 1;
+	}
+
+	printf("%-10s %16s %16s %10s %14s %8s %10s %10s %14s %10s\n", "proposal", "estimate", "std error", "error",
+		   "ESS", "ESS/N", "time (s)", "CPU (s)", "ESS/CPU s", "gain");
+
+	double referenceRate = 0;
+	const Importance_Proposal *proposal;
+	for (int i = 0; (proposal = Importance_Proposal_Get(i)) != NULL; i++)
+	{
+		if (name != NULL && strcmp(proposal->name, name) != 0)
+		{
+			continue;
+		}
+
+		Importance_Report report = Importance_Run(problem, proposal, (uint64_t)number_of_samples, seed);
+
+		double rate = report.cpuSeconds > 0 ? report.effectiveSamples / report.cpuSeconds : 0;
+		if (i == 0)
+		{
+			referenceRate = rate;
+		}
+
+		printf("%-10s %16.10e %16.10e %10.2e %14.1f %8.5f %10.4f %10.4f %14.1f", proposal->name, report.estimate,
+			   report.standardError, fabs(report.estimate - problem->exactValue), report.effectiveSamples,
+			   report.effectiveSamples / report.samples, report.seconds, report.cpuSeconds, rate);
+		if (referenceRate > 0)
+		{
+			printf(" %9.1fx", rate / referenceRate);
+		}
+		printf("\n");
+	}
+
+	return 0;
+}
+
+// Times Calculate_Pi_Sequential and Calculate_Pi_Parallel with every kernel this CPU supports
+static void Benchmark_Kernels(long long number_of_tosses, uint64_t seed)
+{
+	struct timeval start, end;
+	const Circle_Kernel *selectedKernel = Active_Kernel;
+
+	printf("%-12s %12s %12s %14s %14s  %s\n", "kernel", "seq (s)", "par (s)", "seq Mtoss/s", "par Mtoss/s", "π (parallel)");
+
+	const Circle_Kernel *kernel;
+	for (int i = 0; (kernel = Circle_Kernel_Get(i)) != NULL; i++)
+	{
+		if (!kernel->is_supported())
+		{
+			continue;
+		}
+		Active_Kernel = kernel;
+
+		gettimeofday(&start, NULL);
+		Calculate_Pi_Sequential(number_of_tosses, seed);
+		gettimeofday(&end, NULL);
+		double sequentialSeconds = Elapsed_Seconds(&start, &end);
+
+		gettimeofday(&start, NULL);
+		long double parallel_pi = Calculate_Pi_Parallel(number_of_tosses, seed);
+		gettimeofday(&end, NULL);
+		double parallelSeconds = Elapsed_Seconds(&start, &end);
+
+		printf("%-12s %12.6f %12.6f %14.1f %14.1f  %.10Lf\n", kernel->name, sequentialSeconds, parallelSeconds,
+			   number_of_tosses / sequentialSeconds / 1e6, number_of_tosses / parallelSeconds / 1e6, parallel_pi);
+	}
+
+	Active_Kernel = selectedKernel;
+}
+
+// Times the parallel estimate with the threads pinned by every placement policy in turn
+static void Compare_Placements(long long number_of_tosses, uint64_t seed)
+{
+	struct timeval start, end;
+
+	printf("%-10s %12s %14s  %s\n", "placement", "par (s)", "par Mtoss/s", "π (parallel)");
+	for (int policy = 0; policy < PLACEMENT_NUMBER_OF_POLICIES; policy++)
+	{
+		Placement_Select((Placement_Policy)policy);
+
+		gettimeofday(&start, NULL);
+		long double parallel_pi = Calculate_Pi_Parallel(number_of_tosses, seed);
+		gettimeofday(&end, NULL);
+		double parallelSeconds = Elapsed_Seconds(&start, &end);
+
+		printf("%-10s %12.6f %14.1f  %.10Lf\n", Placement_Policy_Name((Placement_Policy)policy), parallelSeconds,
+			   number_of_tosses / parallelSeconds / 1e6, parallel_pi);
+	}
+	Placement_Select(PLACEMENT_NONE);
+}
+
+static void Print_Usage(const char *program)
+{
+	printf("Usage: %s [options]\n"
+		   "  --tosses N    number of samples to draw, 1e12 style counts are accepted (default 10000000)\n"
+		   "  --seed N      random seed, defaults to the current time (0 with --deterministic)\n"
+		   "  --deterministic\n"
+		   "                split the parallel runs into fixed blocks handed out dynamically and\n"
+		   "                combine them in block order, giving the same result on any thread count\n"
+		   "  --kernel NAME sampling kernel, defaults to the widest one this CPU supports\n"
+		   "  --qmc         estimate pi from scrambled Sobol points instead of random tosses\n"
+		   "  --scrambles N independent scrambles used by --qmc (default 8)\n"
+		   "  --target-error E\n"
+		   "                draw tosses until the estimate is within ±E, --tosses becomes the upper bound\n"
+		   "  --confidence C\n"
+		   "                confidence level of --target-error (default 0.95)\n"
+		   "  --integrate NAME\n"
+		   "                integrate one of the integrands below with --tosses samples\n"
+		   "  --checkpoint FILE\n"
+		   "                long run: count the tosses in epochs, saving progress to FILE after\n"
+		   "                each one, and resume from FILE if it exists; SIGTERM or SIGINT saves\n"
+		   "                the tosses counted so far within a few batches and stops\n"
+		   "  --checkpoint-interval SECONDS\n"
+		   "                target time between checkpoints (default 60)\n"
+		   "  --estimator NAME\n"
+		   "                run a variance reduced estimator (hit-miss, antithetic, stratified,\n"
+		   "                control) or \"all\" to compare them\n"
+		   "  --importance NAME\n"
+		   "                integrate one of the peaked problems below by importance sampling and\n"
+		   "                compare the effective samples per CPU second of the proposals\n"
+		   "  --proposal NAME\n"
+		   "                only run this proposal with --importance\n"
+		   "  --scheduler-stats\n"
+		   "                report the blocks each thread ran in the parallel estimate\n"
+		   "  --generator NAME\n"
+		   "                toss generator feeding the buffered kernel\n"
+		   "  --fused       estimate pi, the unit ball volumes up to 8D and Buffon's needle\n"
+		   "                from one pass of --tosses random vectors\n"
+		   "  --lattice R   deterministic pi from the integer points inside a circle of radius R,\n"
+		   "                1e9 style radii are accepted\n"
+		   "  --shared NAME share the run with every process started with the same NAME, each\n"
+		   "                taking blocks from a POSIX shared memory segment; the first process\n"
+		   "                sets the seed, tosses and kernel; the others adopt its kernel unless\n"
+		   "                --kernel asks for a different one, which is refused\n"
+		   "  --telemetry FILE\n"
+		   "                write the tosses, tosses per second and estimate of every thread to FILE\n"
+		   "  --telemetry-format FORMAT\n"
+		   "                json (one object per line, appended) or prometheus (text format,\n"
+		   "                replaced every sample), defaults to json\n"
+		   "  --telemetry-interval SECONDS\n"
+		   "                time between telemetry samples (default 1)\n"
+		   "  --placement POLICY\n"
+		   "                pin the threads: none, compact, scatter or cores (one per physical\n"
+		   "                core), and print where each one runs (default none)\n"
+		   "  --compare-placement\n"
+		   "                time the parallel estimate with every placement policy\n"
+		   "  --bench-kernels\n"
+		   "                time the sequential and parallel paths with every kernel\n"
+		   "\nKernels:\n",
+		   program);
+	Circle_Kernel_Print_All();
+	printf("\nGenerators:\n");
+	Toss_Generator_Print_All();
+	printf("\nIntegrands:\n");
+	Integrand_Print_All();
+	printf("\nImportance sampling problems:\n");
+	Importance_Problem_Print_All();
+	printf("\nProposals:\n");
+	Importance_Proposal_Print_All();
+}
+
+int main(int argc, char *argv[]) {
 	struct timeval start, end;
 
 	long long num_tosses = 10000000;
+	uint64_t seed = (uint64_t)time(NULL);
+	Active_Kernel = Circle_Kernel_Best();
+	int benchmarkKernels = 0;
+	int quasiMonteCarlo = 0;
+	int scrambles = 8;
+	int tossesGiven = 0;
+	long double targetError = 0;
+	double confidence = 0.95;
+	const Integrand *integrand = NULL;
+	const char *checkpointPath = NULL;
+	const char *estimatorName = NULL;
+	const Importance_Problem *importanceProblem = NULL;
+	const char *proposalName = NULL;
+	double checkpointInterval = 60;
+	int seedGiven = 0;
+	int kernelGiven = 0;
+	int schedulerStats = 0;
+	int fused = 0;
+	long long latticeRadius = 0;
+	const char *telemetryPath = NULL;
+	int telemetryFormat = TELEMETRY_JSON;
+	double telemetryInterval = 1;
+	const char *sharedName = NULL;
+	int placementPolicy = PLACEMENT_NONE;
+	int comparePlacement = 0;
+
+	static const struct option Long_Options[] = {
+		{ "tosses", required_argument, NULL, 'n' },
+		{ "seed",   required_argument, NULL, 's' },
+		{ "kernel", required_argument, NULL, 'k' },
+		{ "bench-kernels", no_argument, NULL, 'B' },
+		{ "qmc",       no_argument,       NULL, 'q' },
+		{ "target-error", required_argument, NULL, 'e' },
+		{ "confidence",   required_argument, NULL, 'c' },
+		{ "integrate",    required_argument, NULL, 'i' },
+		{ "checkpoint",   required_argument, NULL, 'C' },
+		{ "estimator",    required_argument, NULL, 'E' },
+		{ "importance",   required_argument, NULL, 'U' },
+		{ "proposal",     required_argument, NULL, 'Q' },
+		{ "deterministic", no_argument,     NULL, 'D' },
+		{ "scheduler-stats", no_argument,   NULL, 'T' },
+		{ "generator",    required_argument, NULL, 'g' },
+		{ "fused",        no_argument,       NULL, 'F' },
+		{ "lattice",      required_argument, NULL, 'L' },
+		{ "telemetry",    required_argument, NULL, 'M' },
+		{ "shared",       required_argument, NULL, 'H' },
+		{ "placement",    required_argument, NULL, 'P' },
+		{ "compare-placement", no_argument,  NULL, 'A' },
+		{ "telemetry-format", required_argument, NULL, 'O' },
+		{ "telemetry-interval", required_argument, NULL, 'R' },
+		{ "checkpoint-interval", required_argument, NULL, 'I' },
+		{ "scrambles", required_argument, NULL, 'S' },
+		{ "help",   no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int option;
+	while ((option = getopt_long(argc, argv, "n:s:k:h", Long_Options, NULL)) != -1)
+	{
+		switch (option)
+		{
+			case 'n':
+				num_tosses = Parse_Count(optarg);
+				tossesGiven = 1;
+				break;
+			case 's':
+				seed = strtoull(optarg, NULL, 0);
+				seedGiven = 1;
+				break;
+			case 'k':
+				Active_Kernel = Circle_Kernel_Find(optarg);
+				if (Active_Kernel == NULL || !Active_Kernel->is_supported())
+				{
+					fprintf(stderr, "Kernel \"%s\" is unknown or not supported by this CPU\n", optarg);
+					return 1;
+				}
+				kernelGiven = 1;
+				break;
+			case 'B':
+				benchmarkKernels = 1;
+				break;
+			case 'q':
+				quasiMonteCarlo = 1;
+				break;
+			case 'S':
+				scrambles = atoi(optarg);
+				break;
+			case 'e':
+				targetError = strtold(optarg, NULL);
+				break;
+			case 'c':
+				confidence = strtod(optarg, NULL);
+				break;
+			case 'i':
+				integrand = Integrand_Find(optarg);
+				if (integrand == NULL)
+				{
+					fprintf(stderr, "Unknown integrand \"%s\"\n", optarg);
+					return 1;
+				}
+				break;
+			case 'C':
+				checkpointPath = optarg;
+				break;
+			case 'I':
+				checkpointInterval = strtod(optarg, NULL);
+				break;
+			case 'E':
+				estimatorName = optarg;
+				break;
+			case 'U':
+				importanceProblem = Importance_Problem_Find(optarg);
+				if (importanceProblem == NULL)
+				{
+					fprintf(stderr, "Unknown importance sampling problem \"%s\"\n", optarg);
+					return 1;
+				}
+				break;
+			case 'Q':
+				proposalName = optarg;
+				break;
+			case 'D':
+				Deterministic_Blocks = 1;
+				break;
+			case 'T':
+				schedulerStats = 1;
+				break;
+			case 'F':
+				fused = 1;
+				break;
+			case 'L':
+				latticeRadius = Parse_Count(optarg);
+				if (latticeRadius <= 0 || (uint64_t)latticeRadius > Lattice_Max_Radius)
+				{
+					fprintf(stderr, "The lattice radius must be between 1 and %" PRIu64 "\n", Lattice_Max_Radius);
+					return 1;
+				}
+				break;
+			case 'H':
+				sharedName = optarg;
+				break;
+			case 'P':
+				placementPolicy = Placement_Policy_Find(optarg);
+				if (placementPolicy < 0)
+				{
+					fprintf(stderr, "Unknown placement policy \"%s\"\n", optarg);
+					return 1;
+				}
+				break;
+			case 'A':
+				comparePlacement = 1;
+				break;
+			case 'M':
+				telemetryPath = optarg;
+				break;
+			case 'O':
+				telemetryFormat = Telemetry_Format_Find(optarg);
+				if (telemetryFormat < 0)
+				{
+					fprintf(stderr, "Unknown telemetry format \"%s\"\n", optarg);
+					return 1;
+				}
+				break;
+			case 'R':
+				telemetryInterval = strtod(optarg, NULL);
+				break;
+			case 'g':
+			{
+				const Toss_Generator *generator = Toss_Generator_Find(optarg);
+				if (generator == NULL || !generator->is_supported())
+				{
+					fprintf(stderr, "Generator \"%s\" is unknown or not supported by this CPU\n", optarg);
+					return 1;
+				}
+				Toss_Generator_Select(generator);
+				break;
+			}
+			case 'h':
+				Print_Usage(argv[0]);
+				return 0;
+			default:
+				Print_Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (Deterministic_Blocks && !seedGiven)
+	{
+		seed = 0;
+	}
+
+	if (num_tosses <= 0)
+	{
+		fprintf(stderr, "The number of tosses must be positive\n");
+		return 1;
+	}
+
+	// The sampler thread inherits the affinity of the thread that starts it, so it is started
+	// before placement pins this one to worker 0's CPU
+	if (telemetryPath != NULL)
+	{
+		if (telemetryInterval <= 0)
+		{
+			fprintf(stderr, "The telemetry interval must be positive\n");
+			return 1;
+		}
+		if (Telemetry_Start(telemetryPath, (Telemetry_Format)telemetryFormat, telemetryInterval, omp_get_max_threads()) != 0)
+		{
+			perror(telemetryPath);
+			return 1;
+		}
+		// Every way out of main writes the final sample
+		atexit(Telemetry_Stop);
+	}
+
+	if (placementPolicy != PLACEMENT_NONE)
+	{
+		// Before anything allocates per thread state, so it is first touched on the right node
+		Placement_Select((Placement_Policy)placementPolicy);
+		printf("Threads placed %s:\n", Placement_Policy_Name((Placement_Policy)placementPolicy));
+		Placement_Print_Mapping();
+		printf("\n");
+	}
+
+	if (sharedName != NULL)
+	{
+		Shared_Run *run;
+		int slot;
+		int match = (seedGiven ? SHARED_RUN_MATCH_SEED : 0) | (tossesGiven ? SHARED_RUN_MATCH_TOSSES : 0);
+		int status = Shared_Run_Join(sharedName, seed, (uint64_t)num_tosses, Active_Kernel->name, match, &run, &slot);
+		// Like a checkpoint, the run is joined with the kernel it was created with unless --kernel says otherwise
+		if (status > 0 && !kernelGiven)
+		{
+			const Circle_Kernel *runKernel = Circle_Kernel_Find(run->kernel);
+			if (runKernel != NULL && runKernel->is_supported() && runKernel != Active_Kernel)
+			{
+				Shared_Run_Leave(run);
+				Active_Kernel = runKernel;
+				status = Shared_Run_Join(sharedName, seed, (uint64_t)num_tosses, Active_Kernel->name, match, &run, &slot);
+			}
+		}
+		if (status < 0)
+		{
+			perror(sharedName);
+			return 1;
+		}
+		if (status > 0)
+		{
+			fprintf(stderr, "%s is a run with seed %" PRIu64 ", %" PRIu64 " tosses and the %s kernel\n", sharedName, run->seed,
+					run->totalTosses, run->kernel);
+			Shared_Run_Leave(run);
+			return 1;
+		}
+
+		printf("Seed %" PRIu64 ", %" PRIu64 " tosses shared as %s, process %d with %d threads, %s kernel\n\n",
+			   run->seed, run->totalTosses, sharedName, slot, omp_get_max_threads(), Active_Kernel->name);
+
+		printf("Timing shared parallel...\n");
+		gettimeofday(&start, NULL);
+		long double shared_pi;
+		if (Calculate_Pi_Shared(run, sharedName, slot, &shared_pi) != 0)
+		{
+			perror(sharedName);
+			Shared_Run_Leave(run);
+			return 1;
+		}
+		gettimeofday(&end, NULL);
+		printf("Took %f seconds\n\n", Elapsed_Seconds(&start, &end));
+
+		Shared_Run_Print(run);
+		printf("\nπ = %.10Lf (shared by %u processes)", shared_pi, atomic_load(&run->processesJoined));
+		Shared_Run_Leave(run);
+		return 0;
+	}
+
+	if (latticeRadius > 0)
+	{
+		printf("Radius %lld, %d threads\n\n", latticeRadius, omp_get_max_threads());
+
+		unsigned __int128 latticePoints;
+		printf("Timing lattice count...\n");
+		gettimeofday(&start, NULL);
+		long double lattice_pi = Calculate_Pi_Lattice((uint64_t)latticeRadius, &latticePoints);
+		gettimeofday(&end, NULL);
+		printf("Took %f seconds\n\n", Elapsed_Seconds(&start, &end));
+
+		char pointsText[40];
+		printf("%s lattice points\n", Format_U128(latticePoints, pointsText));
+		printf("π = %.15Lf (lattice, error %.3Le)", lattice_pi, fabsl(lattice_pi - 3.14159265358979323846264338327950288L));
+		return 0;
+	}
+
+	if (estimatorName != NULL)
+	{
+		printf("Seed %" PRIu64 ", %lld tosses, %d threads\n\n", seed, num_tosses, omp_get_max_threads());
+		return Compare_Estimators(estimatorName, num_tosses, seed);
+	}
+
+	if (importanceProblem != NULL)
+	{
+		printf("Seed %" PRIu64 ", %lld samples of %s, %d threads\n\n", seed, num_tosses, importanceProblem->description,
+			   omp_get_max_threads());
+		return Compare_Proposals(importanceProblem, proposalName, num_tosses, seed);
+	}
+
+	if (checkpointPath != NULL)
+	{
+		Pi_Checkpoint checkpoint;
+		int status = Checkpoint_Read(checkpointPath, &checkpoint);
+		if (status < 0)
+		{
+			fprintf(stderr, "%s is not a valid checkpoint\n", checkpointPath);
+			return 1;
+		}
+
+		if (status == 0)
+		{
+			// A resumed run keeps its seed, toss count and kernel
+			if ((seedGiven && seed != checkpoint.seed) || (tossesGiven && (uint64_t)num_tosses != checkpoint.totalTosses))
+			{
+				fprintf(stderr, "%s belongs to a run with seed %" PRIu64 " and %" PRIu64 " tosses\n",
+						checkpointPath, checkpoint.seed, checkpoint.totalTosses);
+				return 1;
+			}
+			const Circle_Kernel *checkpointKernel = Circle_Kernel_Find(checkpoint.kernel);
+			if (checkpointKernel == NULL || !checkpointKernel->is_supported() || (kernelGiven && checkpointKernel != Active_Kernel))
+			{
+				fprintf(stderr, "%s has to be resumed with the %s kernel\n", checkpointPath, checkpoint.kernel);
+				return 1;
+			}
+			Active_Kernel = checkpointKernel;
+			printf("Resuming %s at toss %" PRIu64 "\n", checkpointPath, checkpoint.completedTosses);
+		}
+		else
+		{
+			memset(&checkpoint, 0, sizeof(checkpoint));
+			checkpoint.seed = seed;
+			checkpoint.totalTosses = (uint64_t)num_tosses;
+			strncpy(checkpoint.kernel, Active_Kernel->name, CHECKPOINT_KERNEL_NAME_LENGTH - 1);
+		}
+
+		printf("Seed %" PRIu64 ", %" PRIu64 " tosses, %s kernel\n\n", checkpoint.seed, checkpoint.totalTosses, Active_Kernel->name);
+
+		struct sigaction stopAction;
+		memset(&stopAction, 0, sizeof(stopAction));
+		stopAction.sa_handler = Request_Stop;
+		sigaction(SIGTERM, &stopAction, NULL);
+		sigaction(SIGINT, &stopAction, NULL);
+
+		printf("Timing long run...\n");
+		gettimeofday(&start, NULL);
+		status = Calculate_Pi_Long_Run(&checkpoint, checkpointPath, checkpointInterval);
+		gettimeofday(&end, NULL);
+		printf("Took %f seconds\n\n", Elapsed_Seconds(&start, &end));
+
+		if (status < 0)
+		{
+			perror(checkpointPath);
+			return 1;
+		}
+		if (status > 0)
+		{
+			printf("Stopped at toss %" PRIu64 ", rerun with --checkpoint %s to resume", checkpoint.completedTosses, checkpointPath);
+			return 3;
+		}
+
+		printf("π = %.10Lf (long run)", (long double)checkpoint.samplesInCircle / checkpoint.totalTosses * 4);
+		return 0;
+	}
+
+	if (integrand != NULL)
+	{
+		printf("Seed %" PRIu64 ", %lld samples of %s\n\n", seed, num_tosses, integrand->description);
+
+		printf("Timing parallel integration...\n");
+		gettimeofday(&start, NULL);
+		Integration_Result result = Integrate_Parallel(integrand->sum, &integrand->box, (uint64_t)num_tosses, seed,
+															   Deterministic_Blocks);
+		gettimeofday(&end, NULL);
+		printf("Took %f seconds\n\n", Elapsed_Seconds(&start, &end));
+
+		printf("%s = %.10f ± %.10f (exact %.10f, error %.3e)", integrand->name, result.estimate,
+			   result.standardError, integrand->exactValue, fabs(result.estimate - integrand->exactValue));
+		return 0;
+	}
+
+	if (targetError > 0)
+	{
+		if (confidence <= 0 || confidence >= 1)
+		{
+			fprintf(stderr, "The confidence level must be between 0 and 1\n");
+			return 1;
+		}
+
+		uint64_t maxTosses = tossesGiven ? (uint64_t)num_tosses : UINT64_MAX / 2;
+		printf("Seed %" PRIu64 ", target ±%Lg at %g%% confidence, %s kernel\n\n", seed, targetError, confidence * 100, Active_Kernel->name);
+
+		uint64_t tossesUsed;
+		long double halfWidth;
+		printf("Timing adaptive parallel...\n");
+		gettimeofday(&start, NULL);
+		long double adaptive_pi = Calculate_Pi_Adaptive(targetError, confidence, maxTosses, seed, &tossesUsed, &halfWidth);
+		gettimeofday(&end, NULL);
+		printf("Took %f seconds for %" PRIu64 " tosses\n\n", Elapsed_Seconds(&start, &end), tossesUsed);
+
+		printf("π = %.10Lf ± %.10Lf (adaptive parallel)", adaptive_pi, halfWidth);
+		if (halfWidth > targetError)
+		{
+			fprintf(stderr, "\nStopped at the --tosses limit before reaching the target error\n");
+			return 2;
+		}
+		return 0;
+	}
+
+	if (quasiMonteCarlo)
+	{
+		if (scrambles <= 0 || (uint64_t)num_tosses / scrambles == 0 || (uint64_t)num_tosses / scrambles > SOBOL_MAX_POINTS)
+		{
+			fprintf(stderr, "Each scramble needs between 1 and 2^32 points\n");
+			return 1;
+		}
+
+		printf("Seed %" PRIu64 ", %d scrambles of %lld Sobol points\n\n", seed, scrambles, num_tosses / scrambles);
+
+		long double standardError;
+		printf("Timing quasi-Monte Carlo...\n");
+		gettimeofday(&start, NULL);
+		long double qmc_pi = Calculate_Pi_Qmc_Parallel(num_tosses, seed, scrambles, &standardError);
+		gettimeofday(&end, NULL);
+		printf("Took %f seconds\n\n", Elapsed_Seconds(&start, &end));
+
+		// Standard error plain Monte Carlo would have with the same number of tosses
+		double hitRate = M_PI / 4;
+		double monteCarloError = 4 * sqrt(hitRate * (1 - hitRate) / num_tosses);
+
+		printf("π = %.10Lf ± %.10Lf (quasi-Monte Carlo, error %.3Le)\n", qmc_pi, standardError, fabsl(qmc_pi - (long double)M_PI));
+		printf("Plain Monte Carlo standard error for the same tosses: %.10f", monteCarloError);
+		return 0;
+	}
+
+	if (fused)
+	{
+		// --kernel picks the fused kernel for the same instruction set
+		const Fused_Kernel *fusedKernel = kernelGiven ? Fused_Kernel_Find(Active_Kernel->name) : Fused_Kernel_Best();
+		if (fusedKernel == NULL)
+		{
+			fprintf(stderr, "There is no fused kernel for the %s kernel\n", Active_Kernel->name);
+			return 1;
+		}
+
+		printf("Seed %" PRIu64 ", %lld vectors of %d coordinates, %s kernel\n\n", seed, num_tosses, FUSED_DIMENSIONS, fusedKernel->name);
+
+		printf("Timing fused pass...\n");
+		gettimeofday(&start, NULL);
+		Fused_Counts counts = Calculate_Fused_Parallel(fusedKernel, num_tosses, seed);
+		gettimeofday(&end, NULL);
+		double fusedSeconds = Elapsed_Seconds(&start, &end);
+		printf("Took %f seconds\n", fusedSeconds);
+
+		// The circle alone, to show what the other estimators add on top of it
+		gettimeofday(&start, NULL);
+		Calculate_Pi_Parallel(num_tosses, seed);
+		gettimeofday(&end, NULL);
+		printf("Circle only took %f seconds\n\n", Elapsed_Seconds(&start, &end));
+
+		printf("%-8s %14s %14s %14s %14s  %s\n", "name", "estimate", "std error", "exact", "implied π", "description");
+		const Fused_Estimator *estimator;
+		for (int i = 0; (estimator = Fused_Estimator_Get(i)) != NULL; i++)
+		{
+			Fused_Estimate estimate = estimator->finish(estimator, &counts);
+			printf("%-8s %14.10f %14.10f %14.10f %14.10f  %s\n", estimator->name, estimate.estimate,
+				   estimate.standardError, estimator->exactValue, estimate.pi, estimator->description);
+		}
+		return 0;
+	}
+
+	if (comparePlacement)
+	{
+		printf("Seed %" PRIu64 ", %lld tosses, %d threads, %s kernel\n\n", seed, num_tosses, omp_get_max_threads(), Active_Kernel->name);
+		Compare_Placements(num_tosses, seed);
+		return 0;
+	}
+
+	if (benchmarkKernels)
+	{
+		printf("Seed %" PRIu64 ", %lld tosses, %d threads\n\n", seed, num_tosses, omp_get_max_threads());
+		Benchmark_Kernels(num_tosses, seed);
+		return 0;
+	}
+
+	printf("Seed %" PRIu64 ", %lld tosses, %s kernel\n\n", seed, num_tosses, Active_Kernel->name);
 
 	printf("Timing sequential...\n");
 	gettimeofday(&start, NULL);
-	long double sequential_pi = Calculate_Pi_Sequential(num_tosses);
+	long double sequential_pi = Calculate_Pi_Sequential(num_tosses, seed);
 	gettimeofday(&end, NULL);
-	printf("Took %f seconds\n\n", end.tv_sec - start.tv_sec + (double)(end.tv_usec - start.tv_usec) / 1000000);
+	printf("Took %f seconds\n\n", Elapsed_Seconds(&start, &end));
 
 	printf("Timing parallel...\n");
+	Scheduler_Stats stats;
 	gettimeofday(&start, NULL);
-	long double parallel_pi = Calculate_Pi_Parallel(num_tosses);
+	long double parallel_pi = Calculate_Pi_Parallel_Blocks(num_tosses, seed, schedulerStats ? &stats : NULL);
 	gettimeofday(&end, NULL);
-	printf("Took %f seconds\n\n", end.tv_sec - start.tv_sec + (double)(end.tv_usec - start.tv_usec) / 1000000);
+	printf("Took %f seconds\n\n", Elapsed_Seconds(&start, &end));
+
+	if (schedulerStats)
+	{
+		Scheduler_Print_Stats(&stats);
+		Scheduler_Stats_Free(&stats);
+		printf("\n");
+	}
 
 	// This will print the result to 10 decimal places
 	printf("π = %.10Lf (sequential)\n", sequential_pi);
 	printf("π = %.10Lf (parallel)", parallel_pi);
 
 	return 0;
-}
\ No newline at end of file
+}
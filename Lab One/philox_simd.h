@@ -0,0 +1,123 @@
+#ifndef LAB1_PHILOX_SIMD_H
+#define LAB1_PHILOX_SIMD_H
+
+#include <immintrin.h>
+
+#include "rng.h"
+
+/*
+ * Philox4x32-10 for 8 (AVX2) or 16 (AVX-512) consecutive counter blocks at
+ * once, one block per 32 bit lane. Word w of block i ends up in lane i of
+ * c[w], the same values Philox4x32 returns for each block.
+ *
+ * The functions are compiled for their instruction set through the target
+ * attribute, so only call them after checking the CPU supports it.
+ */
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+
+// Counters of the 8 blocks starting at block, carrying into the high word on wrap around
+TARGET_AVX2
+static inline void Philox_Counters_Avx2(__m256i c[4], uint64_t block, uint32_t stream_id)
+{
+	const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i signBit = _mm256_set1_epi32((int)0x80000000u);
+
+	__m256i base = _mm256_set1_epi32((int)(uint32_t)block);
+	__m256i low = _mm256_add_epi32(base, lane);
+	// AVX2 only has signed compares, flipping the sign bits makes them unsigned
+	__m256i wrapped = _mm256_cmpgt_epi32(_mm256_xor_si256(base, signBit), _mm256_xor_si256(low, signBit));
+
+	c[0] = low;
+	c[1] = _mm256_sub_epi32(_mm256_set1_epi32((int)(uint32_t)(block >> 32)), wrapped);
+	c[2] = _mm256_set1_epi32((int)stream_id);
+	c[3] = _mm256_setzero_si256();
+}
+
+TARGET_AVX2
+static inline __m256i Mulhi_Epu32_Avx2(__m256i a, __m256i b)
+{
+	// _mm256_mul_epu32 only multiplies the even lanes, so the odd lanes are
+	// shifted down, multiplied separately and blended back in
+	__m256i even = _mm256_srli_epi64(_mm256_mul_epu32(a, b), 32);
+	__m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+	return _mm256_blend_epi32(even, odd, 0xAA);
+}
+
+TARGET_AVX2
+static inline void Philox4x32_Avx2(__m256i c[4], Philox_Key key)
+{
+	const __m256i m0 = _mm256_set1_epi32((int)PHILOX_M0);
+	const __m256i m1 = _mm256_set1_epi32((int)PHILOX_M1);
+	__m256i k0 = _mm256_set1_epi32((int)key.k[0]);
+	__m256i k1 = _mm256_set1_epi32((int)key.k[1]);
+
+	for (int round = 0; round < PHILOX_ROUNDS; round++)
+	{
+		__m256i hi0 = Mulhi_Epu32_Avx2(c[0], m0);
+		__m256i hi1 = Mulhi_Epu32_Avx2(c[2], m1);
+		__m256i lo0 = _mm256_mullo_epi32(c[0], m0);
+		__m256i lo1 = _mm256_mullo_epi32(c[2], m1);
+
+		c[0] = _mm256_xor_si256(_mm256_xor_si256(hi1, c[1]), k0);
+		c[2] = _mm256_xor_si256(_mm256_xor_si256(hi0, c[3]), k1);
+		c[1] = lo1;
+		c[3] = lo0;
+
+		k0 = _mm256_add_epi32(k0, _mm256_set1_epi32((int)PHILOX_W0));
+		k1 = _mm256_add_epi32(k1, _mm256_set1_epi32((int)PHILOX_W1));
+	}
+}
+
+// Counters of the 16 blocks starting at block, carrying into the high word on wrap around
+TARGET_AVX512
+static inline void Philox_Counters_Avx512(__m512i c[4], uint64_t block, uint32_t stream_id)
+{
+	const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	__m512i base = _mm512_set1_epi32((int)(uint32_t)block);
+	__m512i low = _mm512_add_epi32(base, lane);
+	__mmask16 wrapped = _mm512_cmplt_epu32_mask(low, base);
+
+	__m512i high = _mm512_set1_epi32((int)(uint32_t)(block >> 32));
+	c[0] = low;
+	c[1] = _mm512_mask_add_epi32(high, wrapped, high, _mm512_set1_epi32(1));
+	c[2] = _mm512_set1_epi32((int)stream_id);
+	c[3] = _mm512_setzero_si512();
+}
+
+TARGET_AVX512
+static inline __m512i Mulhi_Epu32_Avx512(__m512i a, __m512i b)
+{
+	__m512i even = _mm512_srli_epi64(_mm512_mul_epu32(a, b), 32);
+	__m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), _mm512_srli_epi64(b, 32));
+	return _mm512_mask_blend_epi32(0xAAAA, even, odd);
+}
+
+TARGET_AVX512
+static inline void Philox4x32_Avx512(__m512i c[4], Philox_Key key)
+{
+	const __m512i m0 = _mm512_set1_epi32((int)PHILOX_M0);
+	const __m512i m1 = _mm512_set1_epi32((int)PHILOX_M1);
+	__m512i k0 = _mm512_set1_epi32((int)key.k[0]);
+	__m512i k1 = _mm512_set1_epi32((int)key.k[1]);
+
+	for (int round = 0; round < PHILOX_ROUNDS; round++)
+	{
+		__m512i hi0 = Mulhi_Epu32_Avx512(c[0], m0);
+		__m512i hi1 = Mulhi_Epu32_Avx512(c[2], m1);
+		__m512i lo0 = _mm512_mullo_epi32(c[0], m0);
+		__m512i lo1 = _mm512_mullo_epi32(c[2], m1);
+
+		c[0] = _mm512_xor_si512(_mm512_xor_si512(hi1, c[1]), k0);
+		c[2] = _mm512_xor_si512(_mm512_xor_si512(hi0, c[3]), k1);
+		c[1] = lo1;
+		c[3] = lo0;
+
+		k0 = _mm512_add_epi32(k0, _mm512_set1_epi32((int)PHILOX_W0));
+		k1 = _mm512_add_epi32(k1, _mm512_set1_epi32((int)PHILOX_W1));
+	}
+}
+
+#endif //LAB1_PHILOX_SIMD_H
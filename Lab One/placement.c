@@ -0,0 +1,306 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "placement.h"
+
+typedef struct Cpu_Info {
+	int cpu;
+	int node;
+	int package;
+	int core;
+	// 0 for the first logical CPU of its physical core, 1 for the second...
+	int sibling;
+	// Index of the physical core among the cores of its node
+	int coreInNode;
+} Cpu_Info;
+
+// Sort key of one CPU under a policy, compared field by field
+typedef struct Placement_Key {
+	int key[3];
+	int cpu;
+} Placement_Key;
+
+static const char *Policy_Names[PLACEMENT_NUMBER_OF_POLICIES] = { "none", "compact", "scatter", "cores" };
+
+static Cpu_Info *Cpus = NULL;
+static int Number_Of_Cpus = 0;
+static cpu_set_t Allowed_Cpus;
+
+static Placement_Policy Active_Policy = PLACEMENT_NONE;
+// CPUs in the order the threads are pinned to them, for the active policy
+static int *Mapping = NULL;
+static int Mapping_Length = 0;
+
+// CPU the calling thread is pinned to, -1 while it may run anywhere
+static _Thread_local int Pinned_Cpu = -1;
+
+int Placement_Policy_Find(const char *name)
+{
+	for (int i = 0; i < PLACEMENT_NUMBER_OF_POLICIES; i++)
+	{
+		if (strcmp(Policy_Names[i], name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+const char *Placement_Policy_Name(Placement_Policy policy)
+{
+	return Policy_Names[policy];
+}
+
+// Reads one integer from a sysfs file, or returns fallback if there is none
+static int Read_Sysfs_Int(const char *path, int fallback)
+{
+	FILE *file = fopen(path, "r");
+	if (file == NULL)
+	{
+		return fallback;
+	}
+	int value;
+	if (fscanf(file, "%d", &value) != 1)
+	{
+		value = fallback;
+	}
+	fclose(file);
+	return value;
+}
+
+// The node of a CPU is the nodeN link in its sysfs directory, node 0 without NUMA support
+static int Read_Cpu_Node(int cpu)
+{
+	char path[128];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	DIR *directory = opendir(path);
+	if (directory == NULL)
+	{
+		return 0;
+	}
+
+	int node = 0;
+	struct dirent *entry;
+	while ((entry = readdir(directory)) != NULL)
+	{
+		if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+		{
+			node = atoi(entry->d_name + 4);
+			break;
+		}
+	}
+	closedir(directory);
+	return node;
+}
+
+static int Same_Core(const Cpu_Info *a, const Cpu_Info *b)
+{
+	return a->node == b->node && a->package == b->package && a->core == b->core;
+}
+
+static void Read_Topology(void)
+{
+	if (Cpus != NULL)
+	{
+		return;
+	}
+
+	CPU_ZERO(&Allowed_Cpus);
+	if (sched_getaffinity(0, sizeof(Allowed_Cpus), &Allowed_Cpus) != 0)
+	{
+		CPU_SET(0, &Allowed_Cpus);
+	}
+
+	Cpus = calloc(CPU_SETSIZE, sizeof(Cpu_Info));
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if (!CPU_ISSET(cpu, &Allowed_Cpus))
+		{
+			continue;
+		}
+
+		// Without topology files every CPU counts as a core of its own
+		char path[128];
+		Cpu_Info *info = &Cpus[Number_Of_Cpus++];
+		info->cpu = cpu;
+		info->node = Read_Cpu_Node(cpu);
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+		info->package = Read_Sysfs_Int(path, 0);
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+		info->core = Read_Sysfs_Int(path, cpu);
+	}
+
+	for (int i = 0; i < Number_Of_Cpus; i++)
+	{
+		for (int j = 0; j < Number_Of_Cpus; j++)
+		{
+			Cpus[i].sibling += Same_Core(&Cpus[i], &Cpus[j]) && Cpus[j].cpu < Cpus[i].cpu;
+		}
+	}
+
+	// A core's index counts the first siblings of the cores before it on the same node
+	for (int i = 0; i < Number_Of_Cpus; i++)
+	{
+		Cpu_Info *info = &Cpus[i];
+		for (int j = 0; j < Number_Of_Cpus; j++)
+		{
+			const Cpu_Info *other = &Cpus[j];
+			info->coreInNode += other->node == info->node && other->sibling == 0 &&
+								(other->package < info->package ||
+								 (other->package == info->package && other->core < info->core));
+		}
+	}
+}
+
+static int Compare_Keys(const void *a, const void *b)
+{
+	const Placement_Key *x = a, *y = b;
+	for (int i = 0; i < 3; i++)
+	{
+		if (x->key[i] != y->key[i])
+		{
+			return x->key[i] < y->key[i] ? -1 : 1;
+		}
+	}
+	return (x->cpu > y->cpu) - (x->cpu < y->cpu);
+}
+
+static void Build_Mapping(Placement_Policy policy)
+{
+	Placement_Key *keys = malloc(Number_Of_Cpus * sizeof(Placement_Key));
+	int numberOfKeys = 0;
+
+	for (int i = 0; i < Number_Of_Cpus; i++)
+	{
+		const Cpu_Info *info = &Cpus[i];
+		Placement_Key *key = &keys[numberOfKeys];
+		key->cpu = info->cpu;
+
+		switch (policy)
+		{
+			case PLACEMENT_NONE:
+			case PLACEMENT_COMPACT:
+				key->key[0] = info->node;
+				key->key[1] = info->coreInNode;
+				key->key[2] = info->sibling;
+				break;
+			case PLACEMENT_SCATTER:
+				key->key[0] = info->sibling;
+				key->key[1] = info->coreInNode;
+				key->key[2] = info->node;
+				break;
+			case PLACEMENT_CORES:
+				if (info->sibling != 0)
+				{
+					continue;
+				}
+				key->key[0] = info->node;
+				key->key[1] = info->coreInNode;
+				key->key[2] = 0;
+				break;
+			default:
+				break;
+		}
+		numberOfKeys++;
+	}
+
+	qsort(keys, numberOfKeys, sizeof(Placement_Key), Compare_Keys);
+
+	free(Mapping);
+	Mapping = malloc(numberOfKeys * sizeof(int));
+	Mapping_Length = numberOfKeys;
+	for (int i = 0; i < numberOfKeys; i++)
+	{
+		Mapping[i] = keys[i].cpu;
+	}
+	free(keys);
+}
+
+void Placement_Pin_Thread(int thread)
+{
+	int cpu = Active_Policy == PLACEMENT_NONE || Mapping_Length == 0 ? -1 : Mapping[thread % Mapping_Length];
+	if (cpu == Pinned_Cpu)
+	{
+		return;
+	}
+
+	if (cpu < 0)
+	{
+		pthread_setaffinity_np(pthread_self(), sizeof(Allowed_Cpus), &Allowed_Cpus);
+	}
+	else
+	{
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	}
+	Pinned_Cpu = cpu;
+}
+
+void Placement_Select(Placement_Policy policy)
+{
+	Read_Topology();
+	Build_Mapping(policy);
+	Active_Policy = policy;
+
+	// libgomp keeps the threads of a team for the next parallel region, so
+	// they stay pinned; every parallel region still pins again at its start
+	// in case the runtime started new threads
+	#pragma omp parallel num_threads(omp_get_max_threads())
+	Placement_Pin_Thread(omp_get_thread_num());
+}
+
+void Placement_Print_Mapping(void)
+{
+	Read_Topology();
+	printf("%-8s %6s %6s %8s %6s %8s\n", "thread", "cpu", "node", "package", "core", "sibling");
+
+	int numberOfThreads = omp_get_max_threads();
+	for (int thread = 0; thread < numberOfThreads; thread++)
+	{
+		if (Active_Policy == PLACEMENT_NONE || Mapping_Length == 0)
+		{
+			printf("%-8d %6s %6s %8s %6s %8s\n", thread, "any", "-", "-", "-", "-");
+			continue;
+		}
+
+		int cpu = Mapping[thread % Mapping_Length];
+		for (int i = 0; i < Number_Of_Cpus; i++)
+		{
+			if (Cpus[i].cpu == cpu)
+			{
+				printf("%-8d %6d %6d %8d %6d %8d%s\n", thread, cpu, Cpus[i].node, Cpus[i].package, Cpus[i].core,
+					   Cpus[i].sibling, thread >= Mapping_Length ? "  (shared)" : "");
+			}
+		}
+	}
+}
+
+void *Placement_Alloc_Local(size_t size)
+{
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t length = (size + pageSize - 1) / pageSize * pageSize;
+
+	void *memory = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+	{
+		return NULL;
+	}
+	memset(memory, 0, length);
+	return memory;
+}
+
+void Placement_Free_Local(void *memory, size_t size)
+{
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	munmap(memory, (size + pageSize - 1) / pageSize * pageSize);
+}
@@ -0,0 +1,58 @@
+#ifndef LAB1_PLACEMENT_H
+#define LAB1_PLACEMENT_H
+
+#include <stddef.h>
+
+/*
+ * Where the OpenMP threads run.
+ *
+ * The topology of the CPUs this process may use is read from sysfs: the
+ * NUMA node, package and physical core of every logical CPU, and which SMT
+ * sibling of its core it is. A policy turns that into an ordered list of
+ * CPUs and thread i of a team is pinned to entry i (wrapping around when
+ * there are more threads than entries):
+ *
+ *   none     no pinning, the OS places and migrates the threads
+ *   compact  fill one core after the other, SMT siblings next to each other,
+ *            so the team stays on as few cores and nodes as possible
+ *   scatter  round robin over the nodes and then the cores, SMT siblings only
+ *            once every core has a thread, to spread the memory bandwidth
+ *   cores    one thread per physical core, the first sibling of each core
+ *
+ * Every parallel region calls Placement_Pin_Thread at its start, which
+ * costs one compare once the thread is where it belongs, so the policy
+ * holds even for threads the OpenMP runtime started after Placement_Select.
+ *
+ * Memory a thread mostly uses itself is allocated with Placement_Alloc_Local
+ * after the thread is pinned: its pages are first touched by that thread, so
+ * Linux's default first touch policy places them on the thread's node.
+ */
+
+typedef enum Placement_Policy {
+	PLACEMENT_NONE,
+	PLACEMENT_COMPACT,
+	PLACEMENT_SCATTER,
+	PLACEMENT_CORES,
+	PLACEMENT_NUMBER_OF_POLICIES
+} Placement_Policy;
+
+// Returns the policy with the given name, or -1 if there is no such policy
+int Placement_Policy_Find(const char *name);
+
+const char *Placement_Policy_Name(Placement_Policy policy);
+
+// Reads the topology if needed and pins the threads of the default OpenMP team with policy
+void Placement_Select(Placement_Policy policy);
+
+// Pins the calling thread as thread number thread of the selected policy, cheap when it already is
+void Placement_Pin_Thread(int thread);
+
+// Writes the CPU, node, package, core and sibling every thread of the default team is pinned to
+void Placement_Print_Mapping(void);
+
+// Allocates size bytes on whole pages that are first touched, and so placed, by the calling thread
+void *Placement_Alloc_Local(size_t size);
+
+void Placement_Free_Local(void *memory, size_t size);
+
+#endif //LAB1_PLACEMENT_H
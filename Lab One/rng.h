@@ -0,0 +1,109 @@
+#ifndef LAB1_RNG_H
+#define LAB1_RNG_H
+
+#include <stdint.h>
+
+/*
+ * Counter-based random number generator used by the Monte Carlo estimator.
+ *
+ * Philox4x32-10 is described in "Parallel Random Numbers: As Easy as 1, 2, 3"
+ * (Salmon, Moraes, Dror, Shaw - SC'11). Instead of carrying a state that has
+ * to be advanced one step at a time (like rand_r), every output block is a
+ * pure function of a 128 bit counter and a 64 bit key:
+ *
+ *     block = Philox(counter, key)
+ *
+ * This means any position of the sequence can be reached in O(1) by simply
+ * setting the counter, so each thread can generate its own slice of one
+ * global sequence. The result of a run then only depends on the seed and the
+ * number of samples, not on how many threads produced them.
+ *
+ * The counter is laid out as { block low, block high, stream id, 0 } so that
+ * every seed has 2^32 independent streams of 2^64 blocks each.
+ */
+
+typedef struct Philox_Key {
+	uint32_t k[2];
+} Philox_Key;
+
+typedef struct Philox_Block {
+	uint32_t v[4];
+} Philox_Block;
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+static inline Philox_Key Philox_Make_Key(uint64_t seed)
+{
+	Philox_Key key = { { (uint32_t)seed, (uint32_t)(seed >> 32) } };
+	return key;
+}
+
+static inline Philox_Block Philox_Make_Counter(uint64_t block, uint32_t streamId)
+{
+	Philox_Block counter = { { (uint32_t)block, (uint32_t)(block >> 32), streamId, 0 } };
+	return counter;
+}
+
+static inline Philox_Block Philox4x32(Philox_Block counter, Philox_Key key)
+{
+	uint32_t c0 = counter.v[0], c1 = counter.v[1], c2 = counter.v[2], c3 = counter.v[3];
+	uint32_t k0 = key.k[0], k1 = key.k[1];
+
+	for (int round = 0; round < PHILOX_ROUNDS; round++)
+	{
+		uint64_t product0 = (uint64_t)PHILOX_M0 * c0;
+		uint64_t product1 = (uint64_t)PHILOX_M1 * c2;
+
+		uint32_t n0 = (uint32_t)(product1 >> 32) ^ c1 ^ k0;
+		uint32_t n2 = (uint32_t)(product0 >> 32) ^ c3 ^ k1;
+		c1 = (uint32_t)product1;
+		c3 = (uint32_t)product0;
+		c0 = n0;
+		c2 = n2;
+
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+
+	Philox_Block result = { { c0, c1, c2, c3 } };
+	return result;
+}
+
+// A sequential reader over one Philox stream, handing out one 32 bit word at a time
+typedef struct Rng_Stream {
+	Philox_Key key;
+	uint32_t streamId;
+	uint64_t nextBlock;
+	Philox_Block buffer;
+	int wordsUsed;
+} Rng_Stream;
+
+static inline void Rng_Stream_Seek(Rng_Stream *stream, uint64_t wordIndex)
+{
+	stream->nextBlock = wordIndex / 4;
+	stream->buffer = Philox4x32(Philox_Make_Counter(stream->nextBlock++, stream->streamId), stream->key);
+	stream->wordsUsed = (int)(wordIndex % 4);
+}
+
+static inline void Rng_Stream_Init(Rng_Stream *stream, uint64_t seed, uint32_t streamId)
+{
+	stream->key = Philox_Make_Key(seed);
+	stream->streamId = streamId;
+	Rng_Stream_Seek(stream, 0);
+}
+
+static inline uint32_t Rng_Next_U32(Rng_Stream *stream)
+{
+	if (stream->wordsUsed == 4)
+	{
+		stream->buffer = Philox4x32(Philox_Make_Counter(stream->nextBlock++, stream->streamId), stream->key);
+		stream->wordsUsed = 0;
+	}
+	return stream->buffer.v[stream->wordsUsed++];
+}
+
+#endif //LAB1_RNG_H
@@ -0,0 +1,638 @@
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "rng.h"
+#include "philox_simd.h"
+
+/*
+ * Throughput and quality of the generators getRand() could be built on.
+ *
+ * Every generator fills buffers of 32 bit words (the 64 bit ones give two
+ * words per output), either one output at a time ("scalar") or several
+ * independent lanes side by side, vectorised by the compiler ("vector") or
+ * written with intrinsics ("avx2", "avx512"). For each one the benchmark reports:
+ *
+ *   ns/word    time per word on one thread and per thread on all OpenMP
+ *              threads, each thread filling its own stream
+ *   chi2       chi-square of the top 8 bits over 256 buckets
+ *   serial     lag one correlation of consecutive words, as a z score
+ *   birthday   Marsaglia's birthday spacings on the top 24 bits: 512
+ *              birthdays, 1000 years, total repeats against Poisson(2000)
+ *   pi         error of the circle estimate from the same words as the
+ *              scalar kernel uses them, and its z score
+ *
+ * A '!' marks p values below 0.001, or above 0.999 for the chi-square
+ * where too even a spread is as suspicious as too uneven a one. rand_r
+ * only has 31 random bits, its words are shifted up so the low bit is
+ * always zero.
+ */
+
+#define BENCH_BUFFER_WORDS 4096
+
+// State of any of the generators below, big enough for the widest vector one
+typedef union Generator_State {
+	unsigned int randR;
+	uint64_t splitmix;
+	uint64_t splitmixLanes[8];
+	uint64_t xoshiro[4];
+	uint64_t xoshiroLanes[4][8];
+	struct {
+		unsigned __int128 state;
+		unsigned __int128 increment;
+	} pcg;
+	Rng_Stream philox;
+	struct {
+		Philox_Key key;
+		uint64_t nextBlock;
+		uint32_t streamId;
+	} philoxSimd;
+} __attribute__((aligned(64))) Generator_State;
+
+typedef struct Bench_Generator {
+	const char *name;
+	const char *variant;
+	void (*init)(Generator_State *state, uint64_t seed, uint64_t stream);
+	// Fills words with the next count words, count is a multiple of 64
+	void (*fill)(Generator_State *state, uint32_t *words, size_t count);
+	int (*is_supported)(void);
+} Bench_Generator;
+
+static int Always_Supported(void)
+{
+	return 1;
+}
+
+static int Avx2_Supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+static int Avx512_Supported(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+
+/* -------------------------------------------------------------- rand_r --- */
+
+static void Rand_R_Init(Generator_State *state, uint64_t seed, uint64_t stream)
+{
+	state->randR = (unsigned int)(seed ^ (stream * 0x9E3779B9u));
+}
+
+static void Rand_R_Fill(Generator_State *state, uint32_t *words, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		words[i] = (uint32_t)rand_r(&state->randR) << 1;
+	}
+}
+
+/* ------------------------------------------------------------ SplitMix --- */
+
+static inline uint64_t Splitmix_Next(uint64_t *x)
+{
+	uint64_t z = (*x += UINT64_C(0x9E3779B97F4A7C15));
+	z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+	z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+	return z ^ (z >> 31);
+}
+
+static void Splitmix_Init(Generator_State *state, uint64_t seed, uint64_t stream)
+{
+	uint64_t mixer = seed ^ (stream << 32);
+	state->splitmix = Splitmix_Next(&mixer);
+}
+
+static void Splitmix_Fill(Generator_State *state, uint32_t *words, size_t count)
+{
+	for (size_t i = 0; i < count; i += 2)
+	{
+		uint64_t output = Splitmix_Next(&state->splitmix);
+		words[i] = (uint32_t)output;
+		words[i + 1] = (uint32_t)(output >> 32);
+	}
+}
+
+static void Splitmix_Lanes_Init(Generator_State *state, uint64_t seed, uint64_t stream)
+{
+	uint64_t mixer = seed ^ (stream << 32);
+	for (int lane = 0; lane < 8; lane++)
+	{
+		state->splitmixLanes[lane] = Splitmix_Next(&mixer);
+	}
+}
+
+__attribute__((target_clones("avx512f", "avx2", "default")))
+static void Splitmix_Lanes_Fill(Generator_State *state, uint32_t *words, size_t count)
+{
+	uint64_t lanes[8];
+	memcpy(lanes, state->splitmixLanes, sizeof(lanes));
+
+	for (size_t i = 0; i < count; i += 16)
+	{
+		for (int lane = 0; lane < 8; lane++)
+		{
+			uint64_t output = Splitmix_Next(&lanes[lane]);
+			words[i + lane] = (uint32_t)output;
+			words[i + 8 + lane] = (uint32_t)(output >> 32);
+		}
+	}
+
+	memcpy(state->splitmixLanes, lanes, sizeof(lanes));
+}
+
+/* --------------------------------------------------------- xoshiro256** --- */
+
+static inline uint64_t Rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static void Xoshiro_Init(Generator_State *state, uint64_t seed, uint64_t stream)
+{
+	// Streams are seeded apart rather than jumped apart, which is plenty for a benchmark
+	uint64_t mixer = seed ^ (stream << 32);
+	for (int i = 0; i < 4; i++)
+	{
+		state->xoshiro[i] = Splitmix_Next(&mixer);
+	}
+}
+
+static void Xoshiro_Fill(Generator_State *state, uint32_t *words, size_t count)
+{
+	uint64_t s0 = state->xoshiro[0], s1 = state->xoshiro[1], s2 = state->xoshiro[2], s3 = state->xoshiro[3];
+
+	for (size_t i = 0; i < count; i += 2)
+	{
+		uint64_t output = Rotl(s1 * 5, 7) * 9;
+		uint64_t t = s1 << 17;
+		s2 ^= s0;
+		s3 ^= s1;
+		s1 ^= s2;
+		s0 ^= s3;
+		s2 ^= t;
+		s3 = Rotl(s3, 45);
+
+		words[i] = (uint32_t)output;
+		words[i + 1] = (uint32_t)(output >> 32);
+	}
+
+	state->xoshiro[0] = s0;
+	state->xoshiro[1] = s1;
+	state->xoshiro[2] = s2;
+	state->xoshiro[3] = s3;
+}
+
+static void Xoshiro_Lanes_Init(Generator_State *state, uint64_t seed, uint64_t stream)
+{
+	uint64_t mixer = seed ^ (stream << 32);
+	for (int lane = 0; lane < 8; lane++)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			state->xoshiroLanes[i][lane] = Splitmix_Next(&mixer);
+		}
+	}
+}
+
+// Eight independent generators kept as a structure of arrays, one per 64 bit
+// lane. The multiplies by 5 and 9 are shifts and adds since neither AVX2 nor
+// AVX-512F has a 64 bit multiply. The AVX2 fill runs the first four lanes
+TARGET_AVX2
+static inline __m256i Rotl_Avx2(__m256i x, int k)
+{
+	return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+}
+
+TARGET_AVX2
+static void Xoshiro_Avx2_Fill(Generator_State *state, uint32_t *words, size_t count)
+{
+	__m256i s0 = _mm256_loadu_si256((const __m256i *)state->xoshiroLanes[0]);
+	__m256i s1 = _mm256_loadu_si256((const __m256i *)state->xoshiroLanes[1]);
+	__m256i s2 = _mm256_loadu_si256((const __m256i *)state->xoshiroLanes[2]);
+	__m256i s3 = _mm256_loadu_si256((const __m256i *)state->xoshiroLanes[3]);
+
+	for (size_t i = 0; i < count; i += 8)
+	{
+		__m256i scaled = _mm256_add_epi64(_mm256_slli_epi64(s1, 2), s1);
+		__m256i rotated = Rotl_Avx2(scaled, 7);
+		__m256i output = _mm256_add_epi64(_mm256_slli_epi64(rotated, 3), rotated);
+		__m256i t = _mm256_slli_epi64(s1, 17);
+		s2 = _mm256_xor_si256(s2, s0);
+		s3 = _mm256_xor_si256(s3, s1);
+		s1 = _mm256_xor_si256(s1, s2);
+		s0 = _mm256_xor_si256(s0, s3);
+		s2 = _mm256_xor_si256(s2, t);
+		s3 = Rotl_Avx2(s3, 45);
+
+		_mm256_storeu_si256((__m256i *)&words[i], output);
+	}
+
+	_mm256_storeu_si256((__m256i *)state->xoshiroLanes[0], s0);
+	_mm256_storeu_si256((__m256i *)state->xoshiroLanes[1], s1);
+	_mm256_storeu_si256((__m256i *)state->xoshiroLanes[2], s2);
+	_mm256_storeu_si256((__m256i *)state->xoshiroLanes[3], s3);
+}
+
+TARGET_AVX512
+static void Xoshiro_Avx512_Fill(Generator_State *state, uint32_t *words, size_t count)
+{
+	__m512i s0 = _mm512_loadu_si512(state->xoshiroLanes[0]);
+	__m512i s1 = _mm512_loadu_si512(state->xoshiroLanes[1]);
+	__m512i s2 = _mm512_loadu_si512(state->xoshiroLanes[2]);
+	__m512i s3 = _mm512_loadu_si512(state->xoshiroLanes[3]);
+
+	for (size_t i = 0; i < count; i += 16)
+	{
+		__m512i scaled = _mm512_add_epi64(_mm512_slli_epi64(s1, 2), s1);
+		__m512i rotated = _mm512_rol_epi64(scaled, 7);
+		__m512i output = _mm512_add_epi64(_mm512_slli_epi64(rotated, 3), rotated);
+		__m512i t = _mm512_slli_epi64(s1, 17);
+		s2 = _mm512_xor_si512(s2, s0);
+		s3 = _mm512_xor_si512(s3, s1);
+		s1 = _mm512_xor_si512(s1, s2);
+		s0 = _mm512_xor_si512(s0, s3);
+		s2 = _mm512_xor_si512(s2, t);
+		s3 = _mm512_rol_epi64(s3, 45);
+
+		_mm512_storeu_si512(&words[i], output);
+	}
+
+	_mm512_storeu_si512(state->xoshiroLanes[0], s0);
+	_mm512_storeu_si512(state->xoshiroLanes[1], s1);
+	_mm512_storeu_si512(state->xoshiroLanes[2], s2);
+	_mm512_storeu_si512(state->xoshiroLanes[3], s3);
+}
+
+/* --------------------------------------------------------------- PCG64 --- */
+
+// PCG XSL RR 128/64, the generator numpy calls PCG64
+#define PCG_MULTIPLIER (((unsigned __int128)UINT64_C(0x2360ED051FC65DA4) << 64) | UINT64_C(0x4385DF649FCCF645))
+
+static void Pcg_Init(Generator_State *state, uint64_t seed, uint64_t stream)
+{
+	state->pcg.increment = ((unsigned __int128)stream << 1) | 1;
+	state->pcg.state = 0;
+	state->pcg.state = state->pcg.state * PCG_MULTIPLIER + state->pcg.increment;
+	state->pcg.state += seed;
+	state->pcg.state = state->pcg.state * PCG_MULTIPLIER + state->pcg.increment;
+}
+
+static void Pcg_Fill(Generator_State *state, uint32_t *words, size_t count)
+{
+	unsigned __int128 pcgState = state->pcg.state;
+	unsigned __int128 increment = state->pcg.increment;
+
+	for (size_t i = 0; i < count; i += 2)
+	{
+		pcgState = pcgState * PCG_MULTIPLIER + increment;
+		uint64_t folded = (uint64_t)(pcgState >> 64) ^ (uint64_t)pcgState;
+		int rotation = (int)(pcgState >> 122);
+		uint64_t output = (folded >> rotation) | (folded << ((64 - rotation) & 63));
+
+		words[i] = (uint32_t)output;
+		words[i + 1] = (uint32_t)(output >> 32);
+	}
+
+	state->pcg.state = pcgState;
+}
+
+/* -------------------------------------------------------------- Philox --- */
+
+static void Philox_Init(Generator_State *state, uint64_t seed, uint64_t stream)
+{
+	Rng_Stream_Init(&state->philox, seed, (uint32_t)stream);
+}
+
+static void Philox_Fill(Generator_State *state, uint32_t *words, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		words[i] = Rng_Next_U32(&state->philox);
+	}
+}
+
+static void Philox_Simd_Init(Generator_State *state, uint64_t seed, uint64_t stream)
+{
+	state->philoxSimd.key = Philox_Make_Key(seed);
+	state->philoxSimd.nextBlock = 0;
+	state->philoxSimd.streamId = (uint32_t)stream;
+}
+
+// The vector fills store word w of 8 or 16 blocks together, the same words
+// as the scalar stream in a different order
+TARGET_AVX2
+static void Philox_Avx2_Fill(Generator_State *state, uint32_t *words, size_t count)
+{
+	for (size_t i = 0; i < count; i += 32)
+	{
+		__m256i c[4];
+		Philox_Counters_Avx2(c, state->philoxSimd.nextBlock, state->philoxSimd.streamId);
+		Philox4x32_Avx2(c, state->philoxSimd.key);
+		for (int w = 0; w < 4; w++)
+		{
+			_mm256_storeu_si256((__m256i *)&words[i + 8 * w], c[w]);
+		}
+		state->philoxSimd.nextBlock += 8;
+	}
+}
+
+TARGET_AVX512
+static void Philox_Avx512_Fill(Generator_State *state, uint32_t *words, size_t count)
+{
+	for (size_t i = 0; i < count; i += 64)
+	{
+		__m512i c[4];
+		Philox_Counters_Avx512(c, state->philoxSimd.nextBlock, state->philoxSimd.streamId);
+		Philox4x32_Avx512(c, state->philoxSimd.key);
+		for (int w = 0; w < 4; w++)
+		{
+			_mm512_storeu_si512(&words[i + 16 * w], c[w]);
+		}
+		state->philoxSimd.nextBlock += 16;
+	}
+}
+
+static const Bench_Generator Generators[] = {
+	{ "rand_r",       "scalar", Rand_R_Init,         Rand_R_Fill,         Always_Supported },
+	{ "splitmix64",   "scalar", Splitmix_Init,       Splitmix_Fill,       Always_Supported },
+	{ "splitmix64",   "vector", Splitmix_Lanes_Init, Splitmix_Lanes_Fill, Always_Supported },
+	{ "xoshiro256**", "scalar", Xoshiro_Init,        Xoshiro_Fill,        Always_Supported },
+	{ "xoshiro256**", "avx2",   Xoshiro_Lanes_Init,  Xoshiro_Avx2_Fill,   Avx2_Supported },
+	{ "xoshiro256**", "avx512", Xoshiro_Lanes_Init,  Xoshiro_Avx512_Fill, Avx512_Supported },
+	{ "pcg64",        "scalar", Pcg_Init,            Pcg_Fill,            Always_Supported },
+	{ "philox4x32",   "scalar", Philox_Init,         Philox_Fill,         Always_Supported },
+	{ "philox4x32",   "avx2",   Philox_Simd_Init,    Philox_Avx2_Fill,    Avx2_Supported },
+	{ "philox4x32",   "avx512", Philox_Simd_Init,    Philox_Avx512_Fill,  Avx512_Supported },
+};
+
+static const int Number_Of_Generators = sizeof(Generators) / sizeof(Generators[0]);
+
+/* ----------------------------------------------------------- Throughput --- */
+
+// Nanoseconds per word when every thread fills number_of_words from its own stream
+static double Time_Per_Word(const Bench_Generator *generator, uint64_t seed, uint64_t number_of_words, int number_of_threads)
+{
+	uint64_t sink = 0;
+	double start = omp_get_wtime();
+
+	#pragma omp parallel num_threads(number_of_threads) reduction(^:sink)
+	{
+		Generator_State state;
+		_Alignas(64) uint32_t words[BENCH_BUFFER_WORDS];
+		generator->init(&state, seed, (uint64_t)omp_get_thread_num());
+
+		for (uint64_t done = 0; done < number_of_words; done += BENCH_BUFFER_WORDS)
+		{
+			generator->fill(&state, words, BENCH_BUFFER_WORDS);
+			// Keeps the compiler from dropping the fill
+			sink ^= words[done / BENCH_BUFFER_WORDS % BENCH_BUFFER_WORDS];
+		}
+	}
+
+	double seconds = omp_get_wtime() - start;
+	if (sink == UINT64_C(0x5EED))
+	{
+		printf(" ");
+	}
+	return seconds * 1e9 / number_of_words;
+}
+
+/* -------------------------------------------------------------- Battery --- */
+
+// Words drawn for the chi-square, serial correlation and pi tests
+static const uint64_t Battery_Words = UINT64_C(1) << 26;
+
+#define BIRTHDAYS 512
+#define BIRTHDAY_YEARS 1000
+#define BIRTHDAY_DAY_BITS 24
+
+typedef struct Battery_Result {
+	double chiSquareP;
+	double serialZ;
+	double birthdayP;
+	double piError;
+	double piZ;
+} Battery_Result;
+
+// Upper tail probability of a standard normal
+static double Normal_Upper_Tail(double z)
+{
+	return 0.5 * erfc(z / sqrt(2));
+}
+
+// Upper tail probability of a chi-square with degrees_of_freedom, through the Wilson-Hilferty approximation
+static double Chi_Square_Upper_Tail(double chi_square, double degrees_of_freedom)
+{
+	double scale = 2 / (9 * degrees_of_freedom);
+	return Normal_Upper_Tail((cbrt(chi_square / degrees_of_freedom) - (1 - scale)) / sqrt(scale));
+}
+
+static int Compare_U32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+static Battery_Result Run_Battery(const Bench_Generator *generator, uint64_t seed)
+{
+	Generator_State state;
+	_Alignas(64) uint32_t words[BENCH_BUFFER_WORDS];
+	generator->init(&state, seed, 0);
+
+	uint64_t buckets[256] = { 0 };
+	double sumU = 0, sumUU = 0, sumLag = 0, previousU = 0;
+	uint64_t samplesInCircle = 0;
+
+	for (uint64_t done = 0; done < Battery_Words; done += BENCH_BUFFER_WORDS)
+	{
+		generator->fill(&state, words, BENCH_BUFFER_WORDS);
+		for (int i = 0; i < BENCH_BUFFER_WORDS; i++)
+		{
+			buckets[words[i] >> 24]++;
+
+			double u = words[i] * 0x1p-32;
+			sumU += u;
+			sumUU += u * u;
+			sumLag += u * previousU;
+			previousU = u;
+		}
+
+		// The circle test of the scalar kernel on consecutive pairs of words
+		for (int i = 0; i < BENCH_BUFFER_WORDS; i += 2)
+		{
+			double x = (int32_t)words[i] * 0x1p-31;
+			double y = (int32_t)words[i + 1] * 0x1p-31;
+			samplesInCircle += x * x + y * y < 1;
+		}
+	}
+
+	Battery_Result result;
+
+	double expected = (double)Battery_Words / 256;
+	double chiSquare = 0;
+	for (int i = 0; i < 256; i++)
+	{
+		chiSquare += (buckets[i] - expected) * (buckets[i] - expected) / expected;
+	}
+	result.chiSquareP = Chi_Square_Upper_Tail(chiSquare, 255);
+
+	// Lag one autocorrelation, about normal with variance 1/n for independent words
+	double n = (double)Battery_Words;
+	double mean = sumU / n;
+	double variance = sumUU / n - mean * mean;
+	double correlation = (sumLag / (n - 1) - mean * mean) / variance;
+	result.serialZ = correlation * sqrt(n);
+
+	// Birthday spacings: each year the repeated spacings are about Poisson(m^3 / 4n)
+	uint64_t repeats = 0;
+	uint32_t birthdays[BIRTHDAYS];
+	for (int year = 0; year < BIRTHDAY_YEARS; year++)
+	{
+		if (year % (BENCH_BUFFER_WORDS / BIRTHDAYS) == 0)
+		{
+			generator->fill(&state, words, BENCH_BUFFER_WORDS);
+		}
+		const uint32_t *drawn = &words[year % (BENCH_BUFFER_WORDS / BIRTHDAYS) * BIRTHDAYS];
+		for (int i = 0; i < BIRTHDAYS; i++)
+		{
+			birthdays[i] = drawn[i] >> (32 - BIRTHDAY_DAY_BITS);
+		}
+		qsort(birthdays, BIRTHDAYS, sizeof(uint32_t), Compare_U32);
+		for (int i = BIRTHDAYS - 1; i > 0; i--)
+		{
+			birthdays[i] -= birthdays[i - 1];
+		}
+		qsort(birthdays, BIRTHDAYS, sizeof(uint32_t), Compare_U32);
+		for (int i = 1; i < BIRTHDAYS; i++)
+		{
+			repeats += birthdays[i] == birthdays[i - 1];
+		}
+	}
+	double lambda = (double)BIRTHDAYS * BIRTHDAYS * BIRTHDAYS / (4.0 * (1 << BIRTHDAY_DAY_BITS)) * BIRTHDAY_YEARS;
+	result.birthdayP = 2 * Normal_Upper_Tail(fabs(repeats - lambda) / sqrt(lambda));
+
+	double tosses = n / 2;
+	double hitRate = samplesInCircle / tosses;
+	result.piError = 4 * hitRate - M_PI;
+	result.piZ = result.piError / (4 * sqrt(M_PI / 4 * (1 - M_PI / 4) / tosses));
+
+	return result;
+}
+
+/* ----------------------------------------------------------------- Main --- */
+
+static void Print_Usage(const char *program)
+{
+	printf("Usage: %s [options]\n"
+		   "  --words N     words each thread generates for the timings, 1e9 style counts are\n"
+		   "                accepted (default 268435456)\n"
+		   "  --seed N      seed of every generator (default 1)\n"
+		   "  --no-battery  only measure the throughput\n",
+		   program);
+}
+
+// Marks p values small enough to be suspicious
+static char Flag(double p)
+{
+	return p < 0.001 ? '!' : ' ';
+}
+
+// Marks chi-square p values at either end
+static char Flag_Two_Sided(double p)
+{
+	return p < 0.001 || p > 0.999 ? '!' : ' ';
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t numberOfWords = UINT64_C(1) << 28;
+	uint64_t seed = 1;
+	int battery = 1;
+
+	static const struct option Long_Options[] = {
+		{ "words",      required_argument, NULL, 'w' },
+		{ "seed",       required_argument, NULL, 's' },
+		{ "no-battery", no_argument,       NULL, 'b' },
+		{ "help",       no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int option;
+	while ((option = getopt_long(argc, argv, "w:s:h", Long_Options, NULL)) != -1)
+	{
+		switch (option)
+		{
+			case 'w':
+			{
+				char *end;
+				long double words = strtold(optarg, &end);
+				if (end == optarg || *end != '\0' || words < 1 || words >= 0x1p63L)
+				{
+					fprintf(stderr, "The number of words must be a positive count such as 1e9\n");
+					return 1;
+				}
+				numberOfWords = (uint64_t)words;
+				break;
+			}
+			case 's':
+				seed = strtoull(optarg, NULL, 0);
+				break;
+			case 'b':
+				battery = 0;
+				break;
+			case 'h':
+				Print_Usage(argv[0]);
+				return 0;
+			default:
+				Print_Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	// Whole buffers only
+	numberOfWords = (numberOfWords + BENCH_BUFFER_WORDS - 1) / BENCH_BUFFER_WORDS * BENCH_BUFFER_WORDS;
+	int numberOfThreads = omp_get_max_threads();
+
+	printf("Seed %" PRIu64 ", %" PRIu64 " words per thread, %d threads\n\n", seed, numberOfWords, numberOfThreads);
+	printf("%-13s %-7s %9s %9s", "generator", "variant", "ns 1T", "ns/T nT");
+	if (battery)
+	{
+		printf(" %10s %9s %11s %12s %8s", "chi2 p", "serial z", "birthday p", "pi error", "pi z");
+	}
+	printf("\n");
+
+	for (int i = 0; i < Number_Of_Generators; i++)
+	{
+		const Bench_Generator *generator = &Generators[i];
+		if (!generator->is_supported())
+		{
+			continue;
+		}
+
+		double singleThread = Time_Per_Word(generator, seed, numberOfWords, 1);
+		// Per thread, so equal to the single thread time when the threads scale perfectly
+		double allThreads = Time_Per_Word(generator, seed, numberOfWords, numberOfThreads);
+
+		printf("%-13s %-7s %9.3f %9.3f", generator->name, generator->variant, singleThread, allThreads);
+		if (battery)
+		{
+			Battery_Result result = Run_Battery(generator, seed);
+			double serialP = 2 * Normal_Upper_Tail(fabs(result.serialZ));
+			double piP = 2 * Normal_Upper_Tail(fabs(result.piZ));
+			printf(" %9.4f%c %8.2f%c %10.4f%c %12.3e %7.2f%c", result.chiSquareP, Flag_Two_Sided(result.chiSquareP),
+				   result.serialZ, Flag(serialP), result.birthdayP, Flag(result.birthdayP),
+				   result.piError, result.piZ, Flag(piP));
+		}
+		printf("\n");
+	}
+
+	return 0;
+}
@@ -0,0 +1,753 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "circle_kernels.h"
+
+/*
+ * Long lived pi estimation service.
+ *
+ * Keeps a pool of pinned worker threads warm and answers requests sent over
+ * a Unix domain socket, so callers don't pay for a process launch and an
+ * OpenMP team start up on every estimate. The protocol is line based text:
+ *
+ *     PI <id> <tosses> <seed> [interim every N tosses]
+ *         -> INTERIM <id> <tosses done> <estimate>     (only when asked for)
+ *         -> RESULT <id> <tosses> <estimate> <microseconds since the request>
+ *     STATS
+ *         -> STATS <sweeps> <chunks run> <chunks shared>
+ *     anything else
+ *         -> ERROR <message>
+ *
+ * Every loop of the service runs one sweep over all active requests: each
+ * request advances by up to Sweep_Tosses_Per_Request tosses, cut into chunks
+ * on a fixed grid of Chunk_Tosses, and the chunks of all requests are run by
+ * the pool in one go. Small requests therefore share one wake up of the pool,
+ * and because the generator is counter-based two requests with the same seed
+ * read the same tosses, so their identical chunks are only counted once.
+ * The estimates are the same as Calculate_Pi_Parallel gives for that seed.
+ */
+
+// Tosses in one unit of work handed to a pool thread
+static const uint64_t Chunk_Tosses = UINT64_C(1) << 18;
+
+// How far one request advances per sweep, keeps large requests from starving small ones
+static const uint64_t Sweep_Tosses_Per_Request = UINT64_C(1) << 22;
+
+// Pause loops a pool thread spins through before going to sleep between sweeps
+static const int Warm_Spins = 20000;
+
+// Replies a client has left unread beyond which it is dropped rather than queued for
+static const size_t Max_Pending_Output = (size_t)1 << 20;
+
+#define MAX_CLIENTS 1024
+#define MAX_LINE 256
+
+/* --------------------------------------------------------- Thread pool --- */
+
+typedef struct Chunk {
+	uint64_t seed;
+	uint64_t firstToss;
+	uint64_t tosses;
+	uint64_t samplesInCircle;
+} Chunk;
+
+typedef struct Thread_Pool {
+	int numberOfWorkers;
+	pthread_t *workers;
+	Circle_Count_Fn count;
+
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+
+	// Bumped to start a sweep, the workers run chunks until nextChunk passes numberOfChunks
+	_Atomic uint64_t generation;
+	_Atomic int shuttingDown;
+	Chunk *chunks;
+	size_t numberOfChunks;
+	_Atomic size_t nextChunk;
+	_Atomic int busyWorkers;
+} Thread_Pool;
+
+typedef struct Worker_Start {
+	Thread_Pool *pool;
+	int cpu;
+} Worker_Start;
+
+static void Pin_To_Cpu(pthread_t thread, int cpu)
+{
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+}
+
+static void Run_Chunks(Thread_Pool *pool)
+{
+	for (;;)
+	{
+		size_t i = atomic_fetch_add(&pool->nextChunk, 1);
+		if (i >= pool->numberOfChunks)
+		{
+			return;
+		}
+		Chunk *chunk = &pool->chunks[i];
+		chunk->samplesInCircle = pool->count(chunk->firstToss, chunk->tosses, chunk->seed);
+	}
+}
+
+static void *Worker_Main(void *argument)
+{
+	Worker_Start *start = argument;
+	Thread_Pool *pool = start->pool;
+	if (start->cpu >= 0)
+	{
+		Pin_To_Cpu(pthread_self(), start->cpu);
+	}
+	free(start);
+
+	uint64_t seen = 0;
+	for (;;)
+	{
+		// Spinning for a while first means back to back sweeps don't pay for a wake up
+		uint64_t generation = atomic_load(&pool->generation);
+		for (int spin = 0; spin < Warm_Spins && generation == seen; spin++)
+		{
+			__builtin_ia32_pause();
+			generation = atomic_load(&pool->generation);
+		}
+		if (generation == seen)
+		{
+			pthread_mutex_lock(&pool->lock);
+			while ((generation = atomic_load(&pool->generation)) == seen)
+			{
+				pthread_cond_wait(&pool->wake, &pool->lock);
+			}
+			pthread_mutex_unlock(&pool->lock);
+		}
+		seen = generation;
+
+		if (atomic_load(&pool->shuttingDown))
+		{
+			return NULL;
+		}
+
+		Run_Chunks(pool);
+
+		if (atomic_fetch_sub(&pool->busyWorkers, 1) == 1)
+		{
+			pthread_mutex_lock(&pool->lock);
+			pthread_cond_signal(&pool->done);
+			pthread_mutex_unlock(&pool->lock);
+		}
+	}
+}
+
+// Starts number_of_threads - 1 workers, the calling thread is the last member of the pool
+static void Pool_Start(Thread_Pool *pool, int number_of_threads, Circle_Count_Fn count)
+{
+	memset(pool, 0, sizeof(*pool));
+	pool->numberOfWorkers = number_of_threads - 1;
+	pool->workers = calloc((size_t)number_of_threads, sizeof(pthread_t));
+	pool->count = count;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	// One thread per allowed CPU, in order, starting with the calling thread
+	cpu_set_t allowed;
+	int cpus[CPU_SETSIZE];
+	int numberOfCpus = 0;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+	{
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		{
+			if (CPU_ISSET(cpu, &allowed))
+			{
+				cpus[numberOfCpus++] = cpu;
+			}
+		}
+	}
+
+	if (numberOfCpus > 0)
+	{
+		Pin_To_Cpu(pthread_self(), cpus[0]);
+	}
+	for (int i = 0; i < pool->numberOfWorkers; i++)
+	{
+		Worker_Start *start = malloc(sizeof(Worker_Start));
+		start->pool = pool;
+		start->cpu = numberOfCpus > 0 ? cpus[(i + 1) % numberOfCpus] : -1;
+		pthread_create(&pool->workers[i], NULL, Worker_Main, start);
+	}
+}
+
+// Runs every chunk on the pool and returns once all of them are counted
+static void Pool_Run(Thread_Pool *pool, Chunk *chunks, size_t number_of_chunks)
+{
+	pool->chunks = chunks;
+	pool->numberOfChunks = number_of_chunks;
+	atomic_store(&pool->nextChunk, 0);
+	atomic_store(&pool->busyWorkers, pool->numberOfWorkers);
+
+	pthread_mutex_lock(&pool->lock);
+	atomic_fetch_add(&pool->generation, 1);
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	Run_Chunks(pool);
+
+	for (int spin = 0; spin < Warm_Spins && atomic_load(&pool->busyWorkers) != 0; spin++)
+	{
+		__builtin_ia32_pause();
+	}
+	pthread_mutex_lock(&pool->lock);
+	while (atomic_load(&pool->busyWorkers) != 0)
+	{
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void Pool_Stop(Thread_Pool *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	atomic_store(&pool->shuttingDown, 1);
+	atomic_fetch_add(&pool->generation, 1);
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (int i = 0; i < pool->numberOfWorkers; i++)
+	{
+		pthread_join(pool->workers[i], NULL);
+	}
+	free(pool->workers);
+}
+
+/* ------------------------------------------------------------- Service --- */
+
+typedef struct Client {
+	int fd;
+	char line[MAX_LINE];
+	size_t used;
+	// Replies the socket hasn't taken yet, output[sent, queued) is still to go
+	char *output;
+	size_t sent;
+	size_t queued;
+	size_t outputCapacity;
+	// Set once the client stopped reading or its socket failed, the poll loop then drops it
+	int failed;
+} Client;
+
+typedef struct Request {
+	int client;
+	uint64_t id;
+	uint64_t seed;
+	uint64_t totalTosses;
+	uint64_t doneTosses;
+	uint64_t samplesInCircle;
+	uint64_t interimEvery;
+	uint64_t nextInterim;
+	struct timeval received;
+} Request;
+
+typedef struct Service {
+	Thread_Pool pool;
+	Client clients[MAX_CLIENTS];
+	int numberOfClients;
+
+	Request *requests;
+	size_t numberOfRequests;
+	size_t requestCapacity;
+
+	// Chunks of the current sweep and an open addressing index over them
+	Chunk *chunks;
+	size_t numberOfChunks;
+	size_t chunkCapacity;
+	int64_t *chunkIndex;
+	size_t chunkIndexSize;
+
+	uint64_t sweeps;
+	uint64_t chunksRun;
+	uint64_t chunksShared;
+} Service;
+
+static volatile sig_atomic_t Stop_Requested = 0;
+
+static void Request_Stop(int signal_number)
+{
+	(void)signal_number;
+	Stop_Requested = 1;
+}
+
+// Sends as much queued output as the socket takes without blocking, returns 0 if the client is gone
+static int Flush_Client(Client *client)
+{
+	while (client->sent < client->queued)
+	{
+		ssize_t written = send(client->fd, client->output + client->sent, client->queued - client->sent, MSG_NOSIGNAL);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+		client->sent += (size_t)written;
+	}
+
+	client->sent = 0;
+	client->queued = 0;
+	return 1;
+}
+
+static void Send_Line(Client *client, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// Queues a reply and sends what the socket takes right away, the poll loop sends the rest once
+// the client reads again. The loop never waits on a client, so one that stops reading can't stall
+// the others
+static void Send_Line(Client *client, const char *format, ...)
+{
+	char line[MAX_LINE];
+	va_list arguments;
+	va_start(arguments, format);
+	int length = vsnprintf(line, sizeof(line), format, arguments);
+	va_end(arguments);
+
+	if (length <= 0 || client->failed)
+	{
+		return;
+	}
+	size_t size = (size_t)length < sizeof(line) ? (size_t)length : sizeof(line) - 1;
+	if (client->queued - client->sent + size > Max_Pending_Output)
+	{
+		client->failed = 1;
+		return;
+	}
+
+	if (client->queued + size > client->outputCapacity)
+	{
+		memmove(client->output, client->output + client->sent, client->queued - client->sent);
+		client->queued -= client->sent;
+		client->sent = 0;
+	}
+	if (client->queued + size > client->outputCapacity)
+	{
+		client->outputCapacity = client->outputCapacity ? 2 * client->outputCapacity : 4096;
+		client->output = realloc(client->output, client->outputCapacity);
+	}
+	memcpy(client->output + client->queued, line, size);
+	client->queued += size;
+
+	if (!Flush_Client(client))
+	{
+		client->failed = 1;
+	}
+}
+
+static uint64_t Hash_Chunk(uint64_t seed, uint64_t first_toss, uint64_t tosses)
+{
+	uint64_t hash = seed * UINT64_C(0x9E3779B97F4A7C15) ^ first_toss * UINT64_C(0xC2B2AE3D27D4EB4F) ^ tosses;
+	return hash ^ hash >> 31;
+}
+
+// Returns the index of the chunk covering these tosses, adding it to the sweep if it is new
+static size_t Find_Or_Add_Chunk(Service *service, uint64_t seed, uint64_t first_toss, uint64_t tosses, int add)
+{
+	size_t mask = service->chunkIndexSize - 1;
+	for (size_t slot = Hash_Chunk(seed, first_toss, tosses) & mask;; slot = (slot + 1) & mask)
+	{
+		int64_t index = service->chunkIndex[slot];
+		if (index < 0)
+		{
+			if (!add)
+			{
+				abort();
+			}
+			Chunk *chunk = &service->chunks[service->numberOfChunks];
+			chunk->seed = seed;
+			chunk->firstToss = first_toss;
+			chunk->tosses = tosses;
+			chunk->samplesInCircle = 0;
+			service->chunkIndex[slot] = (int64_t)service->numberOfChunks;
+			return service->numberOfChunks++;
+		}
+
+		Chunk *chunk = &service->chunks[index];
+		if (chunk->seed == seed && chunk->firstToss == first_toss && chunk->tosses == tosses)
+		{
+			if (add)
+			{
+				service->chunksShared++;
+			}
+			return (size_t)index;
+		}
+	}
+}
+
+// Visits the chunks request advances through in this sweep, on the fixed Chunk_Tosses grid
+static uint64_t Sweep_Request_Chunks(Service *service, const Request *request, int add)
+{
+	uint64_t endToss = request->totalTosses - request->doneTosses < Sweep_Tosses_Per_Request
+		? request->totalTosses : request->doneTosses + Sweep_Tosses_Per_Request;
+
+	uint64_t samplesInCircle = 0;
+	for (uint64_t toss = request->doneTosses; toss < endToss;)
+	{
+		uint64_t chunkEnd = (toss / Chunk_Tosses + 1) * Chunk_Tosses;
+		if (chunkEnd > endToss)
+		{
+			chunkEnd = endToss;
+		}
+		size_t index = Find_Or_Add_Chunk(service, request->seed, toss, chunkEnd - toss, add);
+		samplesInCircle += service->chunks[index].samplesInCircle;
+		toss = chunkEnd;
+	}
+	return samplesInCircle;
+}
+
+static void Run_Sweep(Service *service)
+{
+	// Sizes the chunk list and index for the worst case of no shared chunks
+	size_t maximumChunks = service->numberOfRequests * (Sweep_Tosses_Per_Request / Chunk_Tosses + 1);
+	if (maximumChunks > service->chunkCapacity)
+	{
+		service->chunkCapacity = maximumChunks;
+		service->chunks = realloc(service->chunks, maximumChunks * sizeof(Chunk));
+	}
+	size_t indexSize = 64;
+	while (indexSize < 2 * maximumChunks)
+	{
+		indexSize *= 2;
+	}
+	if (indexSize > service->chunkIndexSize)
+	{
+		service->chunkIndexSize = indexSize;
+		service->chunkIndex = realloc(service->chunkIndex, indexSize * sizeof(int64_t));
+	}
+	memset(service->chunkIndex, 0xFF, service->chunkIndexSize * sizeof(int64_t));
+	service->numberOfChunks = 0;
+
+	for (size_t i = 0; i < service->numberOfRequests; i++)
+	{
+		Sweep_Request_Chunks(service, &service->requests[i], 1);
+	}
+
+	Pool_Run(&service->pool, service->chunks, service->numberOfChunks);
+	service->sweeps++;
+	service->chunksRun += service->numberOfChunks;
+
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	size_t kept = 0;
+	for (size_t i = 0; i < service->numberOfRequests; i++)
+	{
+		Request *request = &service->requests[i];
+		uint64_t endToss = request->totalTosses - request->doneTosses < Sweep_Tosses_Per_Request
+			? request->totalTosses : request->doneTosses + Sweep_Tosses_Per_Request;
+
+		request->samplesInCircle += Sweep_Request_Chunks(service, request, 0);
+		request->doneTosses = endToss;
+		long double estimate = (long double)request->samplesInCircle / request->doneTosses * 4;
+		Client *client = &service->clients[request->client];
+
+		if (request->doneTosses == request->totalTosses)
+		{
+			long microseconds = (now.tv_sec - request->received.tv_sec) * 1000000L + (now.tv_usec - request->received.tv_usec);
+			Send_Line(client, "RESULT %" PRIu64 " %" PRIu64 " %.12Lf %ld\n", request->id, request->totalTosses, estimate, microseconds);
+			continue;
+		}
+
+		if (request->interimEvery > 0 && request->doneTosses >= request->nextInterim)
+		{
+			Send_Line(client, "INTERIM %" PRIu64 " %" PRIu64 " %.12Lf\n", request->id, request->doneTosses, estimate);
+			request->nextInterim = (request->doneTosses / request->interimEvery + 1) * request->interimEvery;
+		}
+		service->requests[kept++] = *request;
+	}
+	service->numberOfRequests = kept;
+}
+
+static void Handle_Line(Service *service, int client, char *line)
+{
+	Client *connection = &service->clients[client];
+	char command[16];
+	uint64_t id, tosses, seed, interimEvery = 0;
+
+	int fields = sscanf(line, "%15s %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64, command, &id, &tosses, &seed, &interimEvery);
+	if (fields >= 1 && strcmp(command, "STATS") == 0)
+	{
+		Send_Line(connection, "STATS %" PRIu64 " %" PRIu64 " %" PRIu64 "\n", service->sweeps, service->chunksRun, service->chunksShared);
+		return;
+	}
+	if (fields < 4 || strcmp(command, "PI") != 0 || tosses == 0)
+	{
+		Send_Line(connection, "ERROR expected PI <id> <tosses> <seed> [interim every N tosses]\n");
+		return;
+	}
+
+	if (service->numberOfRequests == service->requestCapacity)
+	{
+		service->requestCapacity = service->requestCapacity ? 2 * service->requestCapacity : 64;
+		service->requests = realloc(service->requests, service->requestCapacity * sizeof(Request));
+	}
+
+	Request *request = &service->requests[service->numberOfRequests++];
+	memset(request, 0, sizeof(*request));
+	request->client = client;
+	request->id = id;
+	request->seed = seed;
+	request->totalTosses = tosses;
+	request->interimEvery = interimEvery;
+	request->nextInterim = interimEvery;
+	gettimeofday(&request->received, NULL);
+}
+
+static void Drop_Client(Service *service, int client)
+{
+	close(service->clients[client].fd);
+	free(service->clients[client].output);
+
+	// Forgets the client's requests and moves the last client into its slot
+	int last = service->numberOfClients - 1;
+	size_t kept = 0;
+	for (size_t i = 0; i < service->numberOfRequests; i++)
+	{
+		Request *request = &service->requests[i];
+		if (request->client == client)
+		{
+			continue;
+		}
+		if (request->client == last)
+		{
+			request->client = client;
+		}
+		service->requests[kept++] = *request;
+	}
+	service->numberOfRequests = kept;
+
+	service->clients[client] = service->clients[last];
+	service->numberOfClients--;
+}
+
+// Reads what the client sent and handles every complete line, returns 0 once the client is gone
+static int Read_Client(Service *service, int client)
+{
+	Client *connection = &service->clients[client];
+	ssize_t received = recv(connection->fd, connection->line + connection->used, MAX_LINE - 1 - connection->used, 0);
+	if (received <= 0)
+	{
+		return received < 0 && (errno == EINTR || errno == EAGAIN);
+	}
+	connection->used += (size_t)received;
+	connection->line[connection->used] = '\0';
+
+	char *lineStart = connection->line;
+	char *newline;
+	while ((newline = strchr(lineStart, '\n')) != NULL)
+	{
+		*newline = '\0';
+		Handle_Line(service, client, lineStart);
+		lineStart = newline + 1;
+	}
+
+	connection->used -= (size_t)(lineStart - connection->line);
+	memmove(connection->line, lineStart, connection->used);
+	if (connection->used == MAX_LINE - 1)
+	{
+		Send_Line(connection, "ERROR line too long\n");
+		return 0;
+	}
+	return 1;
+}
+
+static void Print_Usage(const char *program)
+{
+	printf("Usage: %s --socket PATH [options]\n"
+		   "  --socket PATH   Unix domain socket to listen on\n"
+		   "  --threads N     pool threads, defaults to one per allowed CPU\n"
+		   "  --kernel NAME   sampling kernel, defaults to the widest one this CPU supports\n",
+		   program);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *socketPath = NULL;
+	const Circle_Kernel *kernel = Circle_Kernel_Best();
+
+	cpu_set_t allowed;
+	int numberOfThreads = sched_getaffinity(0, sizeof(allowed), &allowed) == 0 ? CPU_COUNT(&allowed) : 1;
+
+	static const struct option Long_Options[] = {
+		{ "socket",  required_argument, NULL, 's' },
+		{ "threads", required_argument, NULL, 't' },
+		{ "kernel",  required_argument, NULL, 'k' },
+		{ "help",    no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int option;
+	while ((option = getopt_long(argc, argv, "s:t:k:h", Long_Options, NULL)) != -1)
+	{
+		switch (option)
+		{
+			case 's':
+				socketPath = optarg;
+				break;
+			case 't':
+				numberOfThreads = atoi(optarg);
+				break;
+			case 'k':
+				kernel = Circle_Kernel_Find(optarg);
+				if (kernel == NULL || !kernel->is_supported())
+				{
+					fprintf(stderr, "Kernel \"%s\" is unknown or not supported by this CPU\n", optarg);
+					return 1;
+				}
+				break;
+			case 'h':
+				Print_Usage(argv[0]);
+				return 0;
+			default:
+				Print_Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketPath == NULL || numberOfThreads < 1 || strlen(socketPath) >= sizeof(address.sun_path))
+	{
+		Print_Usage(argv[0]);
+		return 1;
+	}
+	strcpy(address.sun_path, socketPath);
+
+	// A socket left behind by an earlier run is replaced, any other file at the path is left alone
+	struct stat existing;
+	if (lstat(socketPath, &existing) == 0)
+	{
+		if (!S_ISSOCK(existing.st_mode))
+		{
+			fprintf(stderr, "%s exists and is not a socket\n", socketPath);
+			return 1;
+		}
+		unlink(socketPath);
+	}
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 128) != 0)
+	{
+		perror(socketPath);
+		return 1;
+	}
+
+	struct sigaction stopAction;
+	memset(&stopAction, 0, sizeof(stopAction));
+	stopAction.sa_handler = Request_Stop;
+	sigaction(SIGTERM, &stopAction, NULL);
+	sigaction(SIGINT, &stopAction, NULL);
+
+	static Service service;
+	Pool_Start(&service.pool, numberOfThreads, kernel->count);
+	printf("Listening on %s with %d threads, %s kernel\n", socketPath, numberOfThreads, kernel->name);
+	fflush(stdout);
+
+	struct pollfd polls[MAX_CLIENTS + 1];
+	while (!Stop_Requested)
+	{
+		polls[0].fd = listener;
+		polls[0].events = POLLIN;
+		for (int i = 0; i < service.numberOfClients; i++)
+		{
+			polls[i + 1].fd = service.clients[i].fd;
+			polls[i + 1].events = POLLIN;
+			polls[i + 1].revents = 0;
+			if (service.clients[i].queued > service.clients[i].sent)
+			{
+				polls[i + 1].events |= POLLOUT;
+			}
+		}
+
+		// Only blocks when there is no sweep waiting to run
+		int ready = poll(polls, (nfds_t)service.numberOfClients + 1, service.numberOfRequests > 0 ? 0 : -1);
+		if (ready < 0 && errno != EINTR)
+		{
+			perror("poll");
+			break;
+		}
+
+		// Walks backwards since dropping a client moves the last one into its slot. Clients the
+		// last sweep marked as failed are dropped even when poll had nothing to report
+		for (int i = service.numberOfClients - 1; i >= 0; i--)
+		{
+			int alive = !service.clients[i].failed;
+			if (alive && (polls[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+			{
+				alive = Read_Client(&service, i);
+			}
+			if (alive && (polls[i + 1].revents & POLLOUT))
+			{
+				alive = Flush_Client(&service.clients[i]);
+			}
+			if (!alive || service.clients[i].failed)
+			{
+				Drop_Client(&service, i);
+			}
+		}
+
+		if (ready > 0 && (polls[0].revents & POLLIN))
+		{
+			int fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK);
+			if (fd >= 0 && service.numberOfClients < MAX_CLIENTS)
+			{
+				Client *client = &service.clients[service.numberOfClients++];
+				memset(client, 0, sizeof(*client));
+				client->fd = fd;
+			}
+			else if (fd >= 0)
+			{
+				static const char Too_Many_Clients[] = "ERROR too many clients\n";
+				send(fd, Too_Many_Clients, sizeof(Too_Many_Clients) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+				close(fd);
+			}
+		}
+
+		if (service.numberOfRequests > 0)
+		{
+			Run_Sweep(&service);
+		}
+	}
+
+	Pool_Stop(&service.pool);
+	for (int i = 0; i < service.numberOfClients; i++)
+	{
+		close(service.clients[i].fd);
+		free(service.clients[i].output);
+	}
+	close(listener);
+	unlink(socketPath);
+	free(service.requests);
+	free(service.chunks);
+	free(service.chunkIndex);
+	return 0;
+}
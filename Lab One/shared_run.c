@@ -0,0 +1,352 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shared_run.h"
+#include "block_scheduler.h"
+
+// "L1SHRUN3", marks a segment written by this version
+static const uint64_t Shared_Run_Magic = UINT64_C(0x334E55524853314C);
+
+// How long waiting processes sleep between looks at the segment
+static const long Poll_Nanoseconds = 1000000;
+
+// How long an attaching process waits for the creator to set the run up
+static const int64_t Setup_Nanoseconds = INT64_C(5000000000);
+
+// Attempts at replacing a stale run before giving up
+static const int Join_Attempts = 3;
+
+static void Sleep_Poll(void)
+{
+	struct timespec pause = { 0, Poll_Nanoseconds };
+	nanosleep(&pause, NULL);
+}
+
+static int64_t Now_Nanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static uint64_t Pid_Namespace(void)
+{
+	struct stat status;
+	return stat("/proc/self/ns/pid", &status) == 0 ? (uint64_t)status.st_ino : 0;
+}
+
+// shm_open names start with a single slash
+static void Segment_Name(const char *name, char *segment_name, size_t size)
+{
+	snprintf(segment_name, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+// Removes the name of the run's segment, unless it already names a newer segment
+static void Remove_Name(const char *segment_name, uint64_t inode)
+{
+	int fd = shm_open(segment_name, O_RDONLY, 0600);
+	if (fd < 0)
+	{
+		return;
+	}
+	struct stat status;
+	if (fstat(fd, &status) == 0 && (uint64_t)status.st_ino == inode)
+	{
+		shm_unlink(segment_name);
+	}
+	close(fd);
+}
+
+// Whether pid is gone or a zombie its parent hasn't waited for yet
+static int Pid_Exited(int32_t pid)
+{
+	if (kill(pid, 0) != 0 && errno == ESRCH)
+	{
+		return 1;
+	}
+
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	FILE *file = fopen(path, "r");
+	if (file == NULL)
+	{
+		return 0;
+	}
+	// The state follows the command name, which is in parentheses and may hold spaces
+	char line[512];
+	char state = 0;
+	if (fgets(line, sizeof(line), file) != NULL)
+	{
+		char *commandEnd = strrchr(line, ')');
+		if (commandEnd != NULL && commandEnd[1] == ' ')
+		{
+			state = commandEnd[2];
+		}
+	}
+	fclose(file);
+	return state == 'Z' || state == 'X';
+}
+
+// Whether the process in slot died before merging its counts
+static int Process_Is_Dead(const Shared_Process *process, uint64_t pid_namespace, int64_t now)
+{
+	int32_t pid = atomic_load(&process->pid);
+	if (pid == 0 || atomic_load(&process->done))
+	{
+		return 0;
+	}
+	if (process->pidNamespace == pid_namespace && Pid_Exited(pid))
+	{
+		return 1;
+	}
+	return now - atomic_load(&process->heartbeat) > (int64_t)SHARED_RUN_STALE_SECONDS * 1000000000;
+}
+
+// Whether any process of the run died before merging its counts
+static int Run_Lost_Process(const Shared_Run *run, uint64_t pid_namespace)
+{
+	uint32_t processes = atomic_load(&run->processesJoined);
+	if (processes > SHARED_RUN_MAX_PROCESSES)
+	{
+		processes = SHARED_RUN_MAX_PROCESSES;
+	}
+
+	int64_t now = Now_Nanoseconds();
+	for (uint32_t i = 0; i < processes; i++)
+	{
+		if (Process_Is_Dead(&run->processes[i], pid_namespace, now))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Try_Join found a stale segment and removed it, the caller can retry
+#define JOIN_STALE 2
+
+// One attempt at creating or attaching to the run, returns what
+// Shared_Run_Join does or JOIN_STALE
+static int Try_Join(const char *segment_name, uint64_t seed, uint64_t total_tosses, const char *kernel, int match,
+					Shared_Run **run, int *slot)
+{
+	int created = 1;
+	int fd = shm_open(segment_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0 && errno == EEXIST)
+	{
+		created = 0;
+		fd = shm_open(segment_name, O_RDWR, 0600);
+	}
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	uint64_t inode = (uint64_t)status.st_ino;
+	int64_t deadline = Now_Nanoseconds() + Setup_Nanoseconds;
+
+	if (created)
+	{
+		if (ftruncate(fd, sizeof(Shared_Run)) != 0)
+		{
+			close(fd);
+			shm_unlink(segment_name);
+			return -1;
+		}
+	}
+	else
+	{
+		// The creator may not have sized the segment yet, or may have died before it could
+		while (fstat(fd, &status) == 0 && (size_t)status.st_size < sizeof(Shared_Run))
+		{
+			if (Now_Nanoseconds() > deadline)
+			{
+				close(fd);
+				Remove_Name(segment_name, inode);
+				return JOIN_STALE;
+			}
+			Sleep_Poll();
+		}
+	}
+
+	Shared_Run *mapped = mmap(NULL, sizeof(Shared_Run), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		return -1;
+	}
+
+	uint64_t pidNamespace = Pid_Namespace();
+	if (created)
+	{
+		// ftruncate zeroed the segment, only the description of the run is left to fill in
+		mapped->magic = Shared_Run_Magic;
+		mapped->inode = inode;
+		mapped->seed = seed;
+		mapped->totalTosses = total_tosses;
+		mapped->numberOfBlocks = Scheduler_Block_Count(total_tosses);
+		strncpy(mapped->kernel, kernel, SHARED_RUN_KERNEL_NAME_LENGTH - 1);
+		atomic_store_explicit(&mapped->ready, 1, memory_order_release);
+	}
+	else
+	{
+		while (!atomic_load_explicit(&mapped->ready, memory_order_acquire))
+		{
+			if (Now_Nanoseconds() > deadline)
+			{
+				munmap(mapped, sizeof(Shared_Run));
+				Remove_Name(segment_name, inode);
+				return JOIN_STALE;
+			}
+			Sleep_Poll();
+		}
+		if (mapped->magic != Shared_Run_Magic)
+		{
+			munmap(mapped, sizeof(Shared_Run));
+			errno = EINVAL;
+			return -1;
+		}
+		// The blocks of a dead process are never merged, so the run could never complete
+		if (Run_Lost_Process(mapped, pidNamespace))
+		{
+			munmap(mapped, sizeof(Shared_Run));
+			Remove_Name(segment_name, inode);
+			return JOIN_STALE;
+		}
+		// Checked before registering, so a process that doesn't take part is never waited for
+		if (((match & SHARED_RUN_MATCH_SEED) && mapped->seed != seed) ||
+			((match & SHARED_RUN_MATCH_TOSSES) && mapped->totalTosses != total_tosses) ||
+			strncmp(mapped->kernel, kernel, SHARED_RUN_KERNEL_NAME_LENGTH - 1) != 0)
+		{
+			*run = mapped;
+			return 1;
+		}
+	}
+
+	uint32_t joined = atomic_fetch_add(&mapped->processesJoined, 1);
+	if (joined >= SHARED_RUN_MAX_PROCESSES)
+	{
+		munmap(mapped, sizeof(Shared_Run));
+		errno = EUSERS;
+		return -1;
+	}
+	Shared_Process *process = &mapped->processes[joined];
+	process->pidNamespace = pidNamespace;
+	atomic_store(&process->heartbeat, Now_Nanoseconds());
+	atomic_store(&process->pid, (int32_t)getpid());
+
+	*run = mapped;
+	*slot = (int)joined;
+	return 0;
+}
+
+int Shared_Run_Join(const char *name, uint64_t seed, uint64_t total_tosses, const char *kernel, int match,
+					Shared_Run **run, int *slot)
+{
+	char segmentName[256];
+	Segment_Name(name, segmentName, sizeof(segmentName));
+
+	for (int attempt = 0; attempt < Join_Attempts; attempt++)
+	{
+		int status = Try_Join(segmentName, seed, total_tosses, kernel, match, run, slot);
+		if (status != JOIN_STALE)
+		{
+			return status;
+		}
+		fprintf(stderr, "Removed the stale run %s left behind by a process that died\n", name);
+	}
+
+	errno = EAGAIN;
+	return -1;
+}
+
+int Shared_Run_Next_Block(Shared_Run *run, uint64_t *first_toss, uint64_t *tosses)
+{
+	uint64_t block = atomic_fetch_add_explicit(&run->nextBlock, 1, memory_order_relaxed);
+	if (block >= run->numberOfBlocks)
+	{
+		return 0;
+	}
+	Scheduler_Block_Range(block, run->totalTosses, first_toss, tosses);
+	return 1;
+}
+
+void Shared_Run_Add(Shared_Run *run, int slot, uint64_t tosses, uint64_t samples_in_circle)
+{
+	Shared_Process *process = &run->processes[slot];
+	atomic_fetch_add_explicit(&process->blocks, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&process->tosses, tosses, memory_order_relaxed);
+	atomic_fetch_add_explicit(&process->samplesInCircle, samples_in_circle, memory_order_relaxed);
+	atomic_store_explicit(&process->heartbeat, Now_Nanoseconds(), memory_order_relaxed);
+}
+
+int Shared_Run_Finish(Shared_Run *run, const char *name, int slot, double seconds)
+{
+	Shared_Process *process = &run->processes[slot];
+	process->seconds = seconds;
+
+	char segmentName[256];
+	Segment_Name(name, segmentName, sizeof(segmentName));
+
+	// The hits go first, so a process that sees every toss merged also sees every hit
+	atomic_fetch_add(&run->mergedSamplesInCircle, atomic_load(&process->samplesInCircle));
+	uint64_t merged = atomic_fetch_add(&run->mergedTosses, atomic_load(&process->tosses)) + atomic_load(&process->tosses);
+	atomic_fetch_add(&run->processesDone, 1);
+	atomic_store(&process->done, 1);
+
+	if (merged == run->totalTosses)
+	{
+		Remove_Name(segmentName, run->inode);
+	}
+
+	uint64_t pidNamespace = Pid_Namespace();
+	while (atomic_load(&run->mergedTosses) < run->totalTosses)
+	{
+		if (Run_Lost_Process(run, pidNamespace))
+		{
+			Remove_Name(segmentName, run->inode);
+			errno = EOWNERDEAD;
+			return -1;
+		}
+		Sleep_Poll();
+	}
+	return 0;
+}
+
+void Shared_Run_Print(const Shared_Run *run)
+{
+	uint32_t processes = atomic_load(&run->processesJoined);
+	if (processes > SHARED_RUN_MAX_PROCESSES)
+	{
+		processes = SHARED_RUN_MAX_PROCESSES;
+	}
+
+	printf("%8s %8s %10s %16s %10s %12s\n", "process", "pid", "blocks", "tosses", "time (s)", "Mtoss/s");
+	for (uint32_t i = 0; i < processes; i++)
+	{
+		const Shared_Process *process = &run->processes[i];
+		uint64_t tosses = atomic_load(&process->tosses);
+		printf("%8u %8d %10llu %16llu %10.4f %12.1f\n", i, process->pid,
+			   (unsigned long long)atomic_load(&process->blocks), (unsigned long long)tosses, process->seconds,
+			   process->seconds > 0 ? tosses / process->seconds / 1e6 : 0);
+	}
+}
+
+void Shared_Run_Leave(Shared_Run *run)
+{
+	munmap(run, sizeof(Shared_Run));
+}
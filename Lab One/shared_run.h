@@ -0,0 +1,110 @@
+#ifndef LAB1_SHARED_RUN_H
+#define LAB1_SHARED_RUN_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/*
+ * One pi estimate shared by several processes on the same machine, for
+ * example one per NUMA node or container, each with its own OpenMP team.
+ *
+ * The processes meet in a POSIX shared memory segment named after the run.
+ * The first one creates it with its seed, toss count and kernel, the others
+ * attach and adopt the seed and toss count. The kernel has to be the same,
+ * since the integer kernels may count a boundary toss differently. The tosses are cut into the scheduler's fixed blocks and
+ * every thread of every process takes the next block from one atomic
+ * counter in the segment, so faster processes simply take more blocks.
+ * Each process adds its tosses and hits to its own slot and, once the
+ * blocks run out, to the merged totals. Since block i always holds the
+ * same tosses the merged estimate is the one Calculate_Pi_Parallel returns
+ * for the seed, no matter how many processes took part.
+ *
+ * The process that completes the last block removes the segment's name,
+ * the others keep their mapping until they exit.
+ *
+ * Every process stamps a heartbeat in its slot with each block it counts.
+ * A process that hasn't finished yet is taken for dead once its pid is gone
+ * (when it shares the pid namespace of whoever looks) or its heartbeat is
+ * older than SHARED_RUN_STALE_SECONDS. Its blocks can't be recovered, so the
+ * processes still waiting for the run remove its name and give up, and a
+ * process that attaches to such a run removes it and creates the run anew.
+ */
+
+#define SHARED_RUN_STALE_SECONDS 10
+
+// What a process attaching to an existing run insists on, see Shared_Run_Join
+#define SHARED_RUN_MATCH_SEED 1
+#define SHARED_RUN_MATCH_TOSSES 2
+
+#define SHARED_RUN_MAX_PROCESSES 64
+
+#define SHARED_RUN_KERNEL_NAME_LENGTH 16
+
+typedef struct Shared_Process {
+	// Written last when joining, 0 while the slot is being filled in
+	_Alignas(64) _Atomic int32_t pid;
+	// Inode of the process' /proc/self/ns/pid, pids only mean something within one namespace
+	uint64_t pidNamespace;
+	// CLOCK_MONOTONIC nanoseconds of the last sign of life
+	_Atomic int64_t heartbeat;
+	// Set once the process' counts are merged
+	_Atomic uint32_t done;
+	_Atomic uint64_t blocks;
+	_Atomic uint64_t tosses;
+	_Atomic uint64_t samplesInCircle;
+	// Wall time from joining until the blocks ran out, written when the process is done
+	double seconds;
+} Shared_Process;
+
+typedef struct Shared_Run {
+	uint64_t magic;
+	// Inode of the segment, tells it from a later segment created under the same name
+	uint64_t inode;
+	uint64_t seed;
+	uint64_t totalTosses;
+	uint64_t numberOfBlocks;
+	// Name of the circle kernel every process counts with
+	char kernel[SHARED_RUN_KERNEL_NAME_LENGTH];
+	// Set once the creator has filled in the fields above
+	_Atomic uint32_t ready;
+	_Atomic uint32_t processesJoined;
+
+	_Alignas(64) _Atomic uint64_t nextBlock;
+
+	_Alignas(64) _Atomic uint64_t mergedTosses;
+	_Atomic uint64_t mergedSamplesInCircle;
+	_Atomic uint32_t processesDone;
+
+	Shared_Process processes[SHARED_RUN_MAX_PROCESSES];
+} Shared_Run;
+
+// Creates the run called name with seed, total_tosses and kernel, or attaches
+// to it if another process already did, waiting until it is set up. A run
+// that is never set up or that lost a process is removed and created anew.
+// On success *run is mapped, *slot is this process' slot and 0 is returned.
+// If the existing run's kernel differs, or its seed or toss count differs
+// where match (a set of SHARED_RUN_MATCH_ flags) asks for it, 1 is returned
+// with *run mapped so they can be reported, but the process doesn't join.
+// Otherwise -1 is returned with errno set
+int Shared_Run_Join(const char *name, uint64_t seed, uint64_t total_tosses, const char *kernel, int match,
+					Shared_Run **run, int *slot);
+
+// Takes the next block of tosses for this process, returns 0 once every block is taken
+int Shared_Run_Next_Block(Shared_Run *run, uint64_t *first_toss, uint64_t *tosses);
+
+// Adds a counted block to the process in slot
+void Shared_Run_Add(Shared_Run *run, int slot, uint64_t tosses, uint64_t samples_in_circle);
+
+// Merges the counts of slot into the totals and waits until every toss of
+// the run has been merged. The process completing the run removes its name.
+// Returns 0 once the run is complete, or removes the run's name and returns
+// -1 with errno set to EOWNERDEAD if another process died before finishing
+int Shared_Run_Finish(Shared_Run *run, const char *name, int slot, double seconds);
+
+// Writes one line per process with its blocks, tosses and throughput
+void Shared_Run_Print(const Shared_Run *run);
+
+// Unmaps the run
+void Shared_Run_Leave(Shared_Run *run);
+
+#endif //LAB1_SHARED_RUN_H
@@ -0,0 +1,87 @@
+#include "sobol.h"
+#include "rng.h"
+
+// Direction numbers of the first two Sobol dimensions. The first is the van
+// der Corput sequence (bit k reversed), the second comes from the primitive
+// polynomial x + 1, where v[k] = v[k - 1] ^ (v[k - 1] >> 1)
+static const uint32_t Direction_Numbers[SOBOL_DIMENSIONS][SOBOL_BITS] = {
+	{
+		0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u, 0x08000000u, 0x04000000u, 0x02000000u, 0x01000000u,
+		0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u, 0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u,
+		0x00008000u, 0x00004000u, 0x00002000u, 0x00001000u, 0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u,
+		0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u, 0x00000008u, 0x00000004u, 0x00000002u, 0x00000001u
+	},
+	{
+		0x80000000u, 0xC0000000u, 0xA0000000u, 0xF0000000u, 0x88000000u, 0xCC000000u, 0xAA000000u, 0xFF000000u,
+		0x80800000u, 0xC0C00000u, 0xA0A00000u, 0xF0F00000u, 0x88880000u, 0xCCCC0000u, 0xAAAA0000u, 0xFFFF0000u,
+		0x80008000u, 0xC000C000u, 0xA000A000u, 0xF000F000u, 0x88008800u, 0xCC00CC00u, 0xAA00AA00u, 0xFF00FF00u,
+		0x80808080u, 0xC0C0C0C0u, 0xA0A0A0A0u, 0xF0F0F0F0u, 0x88888888u, 0xCCCCCCCCu, 0xAAAAAAAAu, 0xFFFFFFFFu
+	}
+};
+
+static uint32_t Reverse_Bits(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+	return __builtin_bswap32(x);
+}
+
+// Laine-Karras style hash that only lets each bit be affected by the bits below
+// it, which on the reversed value is exactly a nested uniform scramble
+static uint32_t Owen_Scramble(uint32_t x, uint32_t seed)
+{
+	x = Reverse_Bits(x);
+	x += seed;
+	x ^= x * 0x6C50B47Cu;
+	x ^= x * 0xB82F1E52u;
+	x ^= x * 0xC7AFE638u;
+	x ^= x * 0x8D22F6E6u;
+	return Reverse_Bits(x);
+}
+
+Sobol_Scramble Sobol_Make_Scramble(uint64_t seed, uint32_t replicate)
+{
+	// The scramble seeds come from their own Philox stream so they never
+	// line up with the words the Monte Carlo kernels use
+	Philox_Block block = Philox4x32(Philox_Make_Counter(replicate, UINT32_C(0x50B0150B)), Philox_Make_Key(seed));
+
+	Sobol_Scramble scramble = { { block.v[0], block.v[1] } };
+	return scramble;
+}
+
+uint64_t Count_Sobol_Samples_In_Circle(uint64_t first_point, uint64_t number_of_points, Sobol_Scramble scramble)
+{
+	// Jumps straight to first_point through its Gray code
+	uint64_t grayCode = first_point ^ (first_point >> 1);
+	uint32_t point[SOBOL_DIMENSIONS] = { 0, 0 };
+	for (int bit = 0; bit < SOBOL_BITS; bit++)
+	{
+		if (grayCode >> bit & 1)
+		{
+			point[0] ^= Direction_Numbers[0][bit];
+			point[1] ^= Direction_Numbers[1][bit];
+		}
+	}
+
+	uint64_t numberOfSamplesInCircle = 0;
+	for (uint64_t i = first_point; i < first_point + number_of_points; i++)
+	{
+		// Maps [0, 2^32) onto [-1, 1) the same way getRand does
+		double x = (int32_t)(Owen_Scramble(point[0], scramble.seed[0]) ^ 0x80000000u) * 0x1p-31;
+		double y = (int32_t)(Owen_Scramble(point[1], scramble.seed[1]) ^ 0x80000000u) * 0x1p-31;
+		if (x * x + y * y < 1) {
+			numberOfSamplesInCircle++;
+		}
+
+		// Consecutive Gray codes differ in the lowest set bit of i + 1
+		int changedBit = __builtin_ctzll(i + 1);
+		if (changedBit < SOBOL_BITS)
+		{
+			point[0] ^= Direction_Numbers[0][changedBit];
+			point[1] ^= Direction_Numbers[1][changedBit];
+		}
+	}
+
+	return numberOfSamplesInCircle;
+}
@@ -0,0 +1,39 @@
+#ifndef LAB1_SOBOL_H
+#define LAB1_SOBOL_H
+
+#include <stdint.h>
+
+/*
+ * Two dimensional Sobol sequence with Owen scrambling, used for the
+ * quasi-Monte Carlo estimate of pi.
+ *
+ * Point i of the sequence is the XOR of the direction numbers selected by the
+ * bits of the Gray code of i, so any point can be computed directly and a
+ * thread can start its slice anywhere. After that, consecutive points differ
+ * by a single XOR.
+ *
+ * Each coordinate is then put through a nested uniform (Owen) scramble, using
+ * the hash based permutation from Burley, "Practical Hash-based Owen
+ * Scrambling" (JCGT 2020). Every scramble seed gives an independent
+ * randomisation of the same low discrepancy point set, so a handful of
+ * scrambles give an unbiased estimate together with its standard error.
+ */
+
+#define SOBOL_DIMENSIONS 2
+#define SOBOL_BITS 32
+
+// The sequence repeats after 2^32 points, so that is the most one scramble can draw
+#define SOBOL_MAX_POINTS (UINT64_C(1) << SOBOL_BITS)
+
+typedef struct Sobol_Scramble {
+	uint32_t seed[SOBOL_DIMENSIONS];
+} Sobol_Scramble;
+
+// Derives the per dimension scramble seeds of one randomisation of the sequence
+Sobol_Scramble Sobol_Make_Scramble(uint64_t seed, uint32_t replicate);
+
+// Counts the points [first_point, first_point + number_of_points) of the
+// scrambled sequence that land in the circle
+uint64_t Count_Sobol_Samples_In_Circle(uint64_t first_point, uint64_t number_of_points, Sobol_Scramble scramble);
+
+#endif //LAB1_SOBOL_H
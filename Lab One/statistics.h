@@ -0,0 +1,13 @@
+#ifndef LAB1_STATISTICS_H
+#define LAB1_STATISTICS_H
+
+// Returns z such that P(Z <= z) = p for a standard normal Z, 0 < p < 1
+double Normal_Quantile(double p);
+
+// Normal_Quantile without the final refinement, relative error about 1e-9 but several times cheaper
+double Normal_Quantile_Approximate(double p);
+
+// Returns the z that makes [-z, z] hold the given two sided confidence level (e.g. 0.95 -> 1.96)
+double Normal_Critical_Value(double confidence);
+
+#endif //LAB1_STATISTICS_H
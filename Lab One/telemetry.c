@@ -0,0 +1,281 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "telemetry.h"
+
+// Counters of one worker, padded so no two workers write the same cache line
+typedef struct Thread_Counters {
+	_Alignas(64) _Atomic uint64_t tosses;
+	_Atomic uint64_t samplesInCircle;
+} Thread_Counters;
+
+typedef struct Telemetry {
+	Thread_Counters *threads;
+	int numberOfThreads;
+
+	const char *path;
+	Telemetry_Format format;
+	FILE *jsonFile;
+	double intervalSeconds;
+
+	pthread_t sampler;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	int stopping;
+
+	struct timespec start;
+	// Tosses of every thread at the previous sample, for the rates
+	uint64_t *previousTosses;
+	double previousSeconds;
+} Telemetry;
+
+static Telemetry Active_Telemetry;
+
+// Set once the sampler runs, Telemetry_Add is a no-op while it is NULL
+static Thread_Counters *Active_Counters = NULL;
+
+static const char *Format_Names[] = { "json", "prometheus" };
+
+int Telemetry_Format_Find(const char *name)
+{
+	for (int i = 0; i < (int)(sizeof(Format_Names) / sizeof(Format_Names[0])); i++)
+	{
+		if (strcmp(Format_Names[i], name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+void Telemetry_Add(int thread, uint64_t tosses, uint64_t samples_in_circle)
+{
+	Thread_Counters *counters = Active_Counters;
+	if (counters == NULL)
+	{
+		return;
+	}
+
+	// The tosses are added first and the hits released after them, so a sampler that acquires the
+	// hits sees at least the tosses they came from
+	Thread_Counters *mine = &counters[thread % Active_Telemetry.numberOfThreads];
+	atomic_fetch_add_explicit(&mine->tosses, tosses, memory_order_relaxed);
+	atomic_fetch_add_explicit(&mine->samplesInCircle, samples_in_circle, memory_order_release);
+}
+
+static double Seconds_Since(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec - start->tv_sec + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double Estimate(uint64_t tosses, uint64_t samples_in_circle)
+{
+	return tosses > 0 ? 4.0 * samples_in_circle / tosses : 0;
+}
+
+static void Write_Json_Sample(Telemetry *telemetry, double seconds, const uint64_t *tosses, const uint64_t *hits,
+							  const double *rates, uint64_t total_tosses, uint64_t total_hits, double total_rate)
+{
+	FILE *file = telemetry->jsonFile;
+
+	fprintf(file, "{\"elapsed\":%.3f,\"tosses\":%llu,\"tosses_per_second\":%.1f,\"estimate\":%.10f,\"threads\":[",
+			seconds, (unsigned long long)total_tosses, total_rate, Estimate(total_tosses, total_hits));
+	for (int i = 0; i < telemetry->numberOfThreads; i++)
+	{
+		fprintf(file, "%s{\"thread\":%d,\"tosses\":%llu,\"tosses_per_second\":%.1f,\"estimate\":%.10f}",
+				i == 0 ? "" : ",", i, (unsigned long long)tosses[i], rates[i], Estimate(tosses[i], hits[i]));
+	}
+	fprintf(file, "]}\n");
+	fflush(file);
+}
+
+static void Write_Prometheus_Sample(Telemetry *telemetry, double seconds, const uint64_t *tosses, const uint64_t *hits,
+									const double *rates, uint64_t total_tosses, uint64_t total_hits)
+{
+	// Written next to the target and renamed over it, so a scrape never sees half a sample
+	char temporaryPath[4096];
+	snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", telemetry->path);
+	FILE *file = fopen(temporaryPath, "w");
+	if (file == NULL)
+	{
+		return;
+	}
+
+	fprintf(file, "# HELP lab1_elapsed_seconds Time since the run started\n"
+				  "# TYPE lab1_elapsed_seconds gauge\n"
+				  "lab1_elapsed_seconds %.3f\n", seconds);
+
+	fprintf(file, "# HELP lab1_tosses_total Tosses counted by each worker thread\n"
+				  "# TYPE lab1_tosses_total counter\n");
+	for (int i = 0; i < telemetry->numberOfThreads; i++)
+	{
+		fprintf(file, "lab1_tosses_total{thread=\"%d\"} %llu\n", i, (unsigned long long)tosses[i]);
+	}
+
+	fprintf(file, "# HELP lab1_hits_total Tosses inside the circle counted by each worker thread\n"
+				  "# TYPE lab1_hits_total counter\n");
+	for (int i = 0; i < telemetry->numberOfThreads; i++)
+	{
+		fprintf(file, "lab1_hits_total{thread=\"%d\"} %llu\n", i, (unsigned long long)hits[i]);
+	}
+
+	fprintf(file, "# HELP lab1_tosses_per_second Tosses per second of each worker over the last interval\n"
+				  "# TYPE lab1_tosses_per_second gauge\n");
+	for (int i = 0; i < telemetry->numberOfThreads; i++)
+	{
+		fprintf(file, "lab1_tosses_per_second{thread=\"%d\"} %.1f\n", i, rates[i]);
+	}
+
+	fprintf(file, "# HELP lab1_pi_estimate Estimate of pi from each worker's tosses and from all of them\n"
+				  "# TYPE lab1_pi_estimate gauge\n");
+	for (int i = 0; i < telemetry->numberOfThreads; i++)
+	{
+		fprintf(file, "lab1_pi_estimate{thread=\"%d\"} %.10f\n", i, Estimate(tosses[i], hits[i]));
+	}
+	fprintf(file, "lab1_pi_estimate{thread=\"all\"} %.10f\n", Estimate(total_tosses, total_hits));
+
+	if (fclose(file) == 0)
+	{
+		rename(temporaryPath, telemetry->path);
+	}
+}
+
+static void Write_Sample(Telemetry *telemetry)
+{
+	int numberOfThreads = telemetry->numberOfThreads;
+	uint64_t *tosses = malloc(numberOfThreads * sizeof(uint64_t));
+	uint64_t *hits = malloc(numberOfThreads * sizeof(uint64_t));
+	double *rates = malloc(numberOfThreads * sizeof(double));
+
+	double seconds = Seconds_Since(&telemetry->start);
+	double interval = seconds - telemetry->previousSeconds > 1e-9 ? seconds - telemetry->previousSeconds : 1e-9;
+	uint64_t totalTosses = 0, totalHits = 0;
+	double totalRate = 0;
+
+	for (int i = 0; i < numberOfThreads; i++)
+	{
+		// The hits are acquired first, so they never belong to more tosses than are read after them
+		hits[i] = atomic_load_explicit(&telemetry->threads[i].samplesInCircle, memory_order_acquire);
+		tosses[i] = atomic_load_explicit(&telemetry->threads[i].tosses, memory_order_relaxed);
+		rates[i] = (tosses[i] - telemetry->previousTosses[i]) / interval;
+
+		totalTosses += tosses[i];
+		totalHits += hits[i];
+		totalRate += rates[i];
+		telemetry->previousTosses[i] = tosses[i];
+	}
+	telemetry->previousSeconds = seconds;
+
+	if (telemetry->format == TELEMETRY_JSON)
+	{
+		Write_Json_Sample(telemetry, seconds, tosses, hits, rates, totalTosses, totalHits, totalRate);
+	}
+	else
+	{
+		Write_Prometheus_Sample(telemetry, seconds, tosses, hits, rates, totalTosses, totalHits);
+	}
+
+	free(tosses);
+	free(hits);
+	free(rates);
+}
+
+static void *Sampler_Main(void *argument)
+{
+	Telemetry *telemetry = argument;
+
+	pthread_mutex_lock(&telemetry->lock);
+	for (;;)
+	{
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		long long nanoseconds = deadline.tv_nsec + (long long)(telemetry->intervalSeconds * 1e9);
+		deadline.tv_sec += nanoseconds / 1000000000;
+		deadline.tv_nsec = nanoseconds % 1000000000;
+
+		while (!telemetry->stopping && pthread_cond_timedwait(&telemetry->wake, &telemetry->lock, &deadline) != ETIMEDOUT)
+		{
+		}
+
+		// The last sample is written on the way out, so the file always ends with the final counts
+		Write_Sample(telemetry);
+		if (telemetry->stopping)
+		{
+			break;
+		}
+	}
+	pthread_mutex_unlock(&telemetry->lock);
+
+	return NULL;
+}
+
+int Telemetry_Start(const char *path, Telemetry_Format format, double interval_seconds, int number_of_threads)
+{
+	Telemetry *telemetry = &Active_Telemetry;
+	memset(telemetry, 0, sizeof(*telemetry));
+
+	if (format == TELEMETRY_JSON)
+	{
+		telemetry->jsonFile = fopen(path, "a");
+		if (telemetry->jsonFile == NULL)
+		{
+			return -1;
+		}
+	}
+
+	telemetry->path = path;
+	telemetry->format = format;
+	telemetry->intervalSeconds = interval_seconds;
+	telemetry->numberOfThreads = number_of_threads;
+	telemetry->threads = aligned_alloc(_Alignof(Thread_Counters), number_of_threads * sizeof(Thread_Counters));
+	telemetry->previousTosses = calloc(number_of_threads, sizeof(uint64_t));
+	for (int i = 0; i < number_of_threads; i++)
+	{
+		atomic_init(&telemetry->threads[i].tosses, 0);
+		atomic_init(&telemetry->threads[i].samplesInCircle, 0);
+	}
+
+	pthread_mutex_init(&telemetry->lock, NULL);
+	pthread_cond_init(&telemetry->wake, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &telemetry->start);
+
+	int error = pthread_create(&telemetry->sampler, NULL, Sampler_Main, telemetry);
+	if (error != 0)
+	{
+		errno = error;
+		return -1;
+	}
+
+	Active_Counters = telemetry->threads;
+	return 0;
+}
+
+void Telemetry_Stop(void)
+{
+	Telemetry *telemetry = &Active_Telemetry;
+	if (Active_Counters == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&telemetry->lock);
+	telemetry->stopping = 1;
+	pthread_cond_signal(&telemetry->wake);
+	pthread_mutex_unlock(&telemetry->lock);
+	pthread_join(telemetry->sampler, NULL);
+
+	Active_Counters = NULL;
+	if (telemetry->jsonFile != NULL)
+	{
+		fclose(telemetry->jsonFile);
+	}
+	free(telemetry->threads);
+	free(telemetry->previousTosses);
+}
@@ -0,0 +1,42 @@
+#ifndef LAB1_TELEMETRY_H
+#define LAB1_TELEMETRY_H
+
+#include <stdint.h>
+
+/*
+ * Live per-thread throughput of a run.
+ *
+ * Every worker adds the tosses it finished and the hits among them to its
+ * own counters, each on its own cache line so the workers never share one.
+ * A sampler thread reads the counters every interval and writes, for every
+ * thread and for the run as a whole, the tosses completed, the tosses per
+ * second since the last sample and the current estimate of pi. That shows
+ * stragglers, cores slowing down and how the estimate converges without
+ * touching the hot loops: a worker only does one relaxed add per block.
+ *
+ * Two formats are written:
+ *
+ *   json        one JSON object per sample appended to the file
+ *   prometheus  the text exposition format, the file is replaced with the
+ *               latest sample each time (for a node_exporter textfile collector)
+ */
+
+typedef enum Telemetry_Format {
+	TELEMETRY_JSON,
+	TELEMETRY_PROMETHEUS
+} Telemetry_Format;
+
+// Returns the format with the given name, or -1 if there is no such format
+int Telemetry_Format_Find(const char *name);
+
+// Starts sampling the counters of number_of_threads workers into path every
+// interval_seconds. Returns 0 on success, -1 with errno set otherwise
+int Telemetry_Start(const char *path, Telemetry_Format format, double interval_seconds, int number_of_threads);
+
+// Adds tosses and their hits to the counters of thread, does nothing unless telemetry was started
+void Telemetry_Add(int thread, uint64_t tosses, uint64_t samples_in_circle);
+
+// Writes a last sample and stops the sampler, safe to call when telemetry was never started
+void Telemetry_Stop(void);
+
+#endif //LAB1_TELEMETRY_H
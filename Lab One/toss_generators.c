@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "toss_generators.h"
+#include "philox_simd.h"
+
+// Stores toss of the global sequence (words 2 * toss and 2 * toss + 1 of stream 0)
+static inline void Single_Toss(Philox_Key key, uint64_t toss, int32_t *x, int32_t *y)
+{
+	Philox_Block block = Philox4x32(Philox_Make_Counter(toss / 2, 0), key);
+	int word = (int)(toss % 2) * 2;
+	*x = (int32_t)block.v[word];
+	*y = (int32_t)block.v[word + 1];
+}
+
+// Four Philox blocks per iteration. They don't depend on each other, so the
+// CPU overlaps their multiply chains instead of running one after the other
+static void Fill_Philox(uint64_t first_toss, size_t number_of_tosses, uint64_t seed, int32_t *xs, int32_t *ys)
+{
+	enum { Lanes = 4 };
+
+	Philox_Key key = Philox_Make_Key(seed);
+	uint64_t toss = first_toss;
+	size_t i = 0;
+
+	if (toss % 2 != 0 && i < number_of_tosses)
+	{
+		Single_Toss(key, toss++, &xs[i], &ys[i]);
+		i++;
+	}
+
+	for (; number_of_tosses - i >= 2 * Lanes; i += 2 * Lanes, toss += 2 * Lanes)
+	{
+		Philox_Block blocks[Lanes];
+		for (int lane = 0; lane < Lanes; lane++)
+		{
+			blocks[lane] = Philox4x32(Philox_Make_Counter(toss / 2 + lane, 0), key);
+		}
+		for (int lane = 0; lane < Lanes; lane++)
+		{
+			xs[i + 2 * lane] = (int32_t)blocks[lane].v[0];
+			ys[i + 2 * lane] = (int32_t)blocks[lane].v[1];
+			xs[i + 2 * lane + 1] = (int32_t)blocks[lane].v[2];
+			ys[i + 2 * lane + 1] = (int32_t)blocks[lane].v[3];
+		}
+	}
+
+	for (; i < number_of_tosses; i++)
+	{
+		Single_Toss(key, toss++, &xs[i], &ys[i]);
+	}
+}
+
+static int Always_Supported(void)
+{
+	return 1;
+}
+
+static int Avx2_Supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+static int Avx512_Supported(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+
+// 8 blocks per step: the first tosses of the blocks go to xs/ys[i, i + 8) and the second ones to [i + 8, i + 16)
+TARGET_AVX2
+static void Fill_Philox_Avx2(uint64_t first_toss, size_t number_of_tosses, uint64_t seed, int32_t *xs, int32_t *ys)
+{
+	Philox_Key key = Philox_Make_Key(seed);
+	uint64_t toss = first_toss;
+	size_t i = 0;
+
+	if (toss % 2 != 0 && i < number_of_tosses)
+	{
+		Single_Toss(key, toss++, &xs[i], &ys[i]);
+		i++;
+	}
+
+	for (; number_of_tosses - i >= 16; i += 16, toss += 16)
+	{
+		__m256i c[4];
+		Philox_Counters_Avx2(c, toss / 2, 0);
+		Philox4x32_Avx2(c, key);
+
+		_mm256_storeu_si256((__m256i *)&xs[i], c[0]);
+		_mm256_storeu_si256((__m256i *)&ys[i], c[1]);
+		_mm256_storeu_si256((__m256i *)&xs[i + 8], c[2]);
+		_mm256_storeu_si256((__m256i *)&ys[i + 8], c[3]);
+	}
+
+	for (; i < number_of_tosses; i++)
+	{
+		Single_Toss(key, toss++, &xs[i], &ys[i]);
+	}
+}
+
+TARGET_AVX512
+static void Fill_Philox_Avx512(uint64_t first_toss, size_t number_of_tosses, uint64_t seed, int32_t *xs, int32_t *ys)
+{
+	Philox_Key key = Philox_Make_Key(seed);
+	uint64_t toss = first_toss;
+	size_t i = 0;
+
+	if (toss % 2 != 0 && i < number_of_tosses)
+	{
+		Single_Toss(key, toss++, &xs[i], &ys[i]);
+		i++;
+	}
+
+	for (; number_of_tosses - i >= 32; i += 32, toss += 32)
+	{
+		__m512i c[4];
+		Philox_Counters_Avx512(c, toss / 2, 0);
+		Philox4x32_Avx512(c, key);
+
+		_mm512_storeu_si512(&xs[i], c[0]);
+		_mm512_storeu_si512(&ys[i], c[1]);
+		_mm512_storeu_si512(&xs[i + 16], c[2]);
+		_mm512_storeu_si512(&ys[i + 16], c[3]);
+	}
+
+	for (; i < number_of_tosses; i++)
+	{
+		Single_Toss(key, toss++, &xs[i], &ys[i]);
+	}
+}
+
+// Ordered from the narrowest to the widest generator
+static const Toss_Generator Generators[] = {
+	{ "philox",        Fill_Philox,        Always_Supported },
+	{ "philox-avx2",   Fill_Philox_Avx2,   Avx2_Supported },
+	{ "philox-avx512", Fill_Philox_Avx512, Avx512_Supported },
+};
+
+static const int Number_Of_Generators = sizeof(Generators) / sizeof(Generators[0]);
+
+static const Toss_Generator *Active_Generator;
+
+const Toss_Generator *Toss_Generator_Find(const char *name)
+{
+	for (int i = 0; i < Number_Of_Generators; i++)
+	{
+		if (strcmp(Generators[i].name, name) == 0)
+		{
+			return &Generators[i];
+		}
+	}
+	return NULL;
+}
+
+const Toss_Generator *Toss_Generator_Best(void)
+{
+	const Toss_Generator *best = &Generators[0];
+	for (int i = 1; i < Number_Of_Generators; i++)
+	{
+		if (Generators[i].is_supported())
+		{
+			best = &Generators[i];
+		}
+	}
+	return best;
+}
+
+const Toss_Generator *Toss_Generator_Active(void)
+{
+	return Active_Generator != NULL ? Active_Generator : Toss_Generator_Best();
+}
+
+void Toss_Generator_Select(const Toss_Generator *generator)
+{
+	Active_Generator = generator;
+}
+
+void Toss_Generator_Print_All(void)
+{
+	for (int i = 0; i < Number_Of_Generators; i++)
+	{
+		printf("  %-14s%s\n", Generators[i].name, Generators[i].is_supported() ? "" : " (not supported by this CPU)");
+	}
+}
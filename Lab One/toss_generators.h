@@ -0,0 +1,48 @@
+#ifndef LAB1_TOSS_GENERATORS_H
+#define LAB1_TOSS_GENERATORS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Generators that fill a buffer with tosses ahead of the circle test.
+ *
+ * Filling a whole L1 sized buffer at once lets the generator run several
+ * independent Philox blocks side by side instead of waiting on one dependency
+ * chain per toss, and the consumer then tests the buffer in a tight
+ * vectorised loop. The coordinates are stored as separate x and y arrays of
+ * signed 32 bit words (x / 2^31 in [-1, 1)), so any generator can feed the
+ * same test kernel.
+ *
+ * A generator may store the tosses of the range in any order, since only the
+ * number of hits is used, but it must produce exactly the tosses of the global
+ * sequence so the count matches the other kernels.
+ */
+
+// Tosses per buffer, two arrays of this many words take 16 KiB of L1
+#define TOSS_BUFFER_SIZE 2048
+
+// Fills xs and ys with the tosses [first_toss, first_toss + number_of_tosses) of the global sequence
+typedef void (*Toss_Fill_Fn)(uint64_t first_toss, size_t number_of_tosses, uint64_t seed, int32_t *xs, int32_t *ys);
+
+typedef struct Toss_Generator {
+	const char *name;
+	Toss_Fill_Fn fill;
+	// Returns non zero when the running CPU can execute the generator
+	int (*is_supported)(void);
+} Toss_Generator;
+
+// Returns the generator with the given name, or NULL if there is no such generator
+const Toss_Generator *Toss_Generator_Find(const char *name);
+
+// Returns the widest generator supported by the running CPU
+const Toss_Generator *Toss_Generator_Best(void);
+
+// Generator used by the buffered circle kernel, the best one unless Toss_Generator_Select was called
+const Toss_Generator *Toss_Generator_Active(void);
+void Toss_Generator_Select(const Toss_Generator *generator);
+
+// Writes the names of every generator, marking the ones this CPU can't run
+void Toss_Generator_Print_All(void);
+
+#endif //LAB1_TOSS_GENERATORS_H
@@ -1,90 +1,407 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <string.h>
+#include <unistd.h>
 #include <omp.h>
 #include <time.h>
 #include <sys/time.h>
 
+#include "sum_kernels.h"
+#include "mapped_file.h"
+#include "stream_sum.h"
+#include "numa_array.h"
+#include "huge_pages.h"
+
 static const long Num_To_Add = 1000000000;
 static const double Scale = 10.0 / RAND_MAX;
 
+// Kernel used by add_serial and add_parallel, picked from the CPU at startup
+static const Sum_Kernel *Active_Kernel;
+
+// Data TLB misses of the timed sums, opened before the OpenMP team exists so it is counted too
+static Tlb_Counter Tlb_Misses;
+
 long add_serial(const char* numbers) {
-	long sum = 0;
-	for (long i = 0; i < Num_To_Add; i++) {
-		sum += numbers[i];
-	}
-	return sum;
+	return Active_Kernel->sum(numbers, Num_To_Add);
 }
 
-long add_parallel(const char* numbers)
+long add_parallel(const Numa_Array* numbers)
 {
-	long totalSum = 0;
+	//Every thread sums the chunk it first touched, on the CPU it touched it from
+	return Numa_Array_Sum(numbers, Active_Kernel->sum, 0);
+}
 
-	int numberOfThreads = omp_get_max_threads();
-	int workloadPerThread = Num_To_Add / numberOfThreads;
-	int extraWorkloadForLastThread = Num_To_Add % numberOfThreads;
+static double Elapsed_Seconds(const struct timeval *start, const struct timeval *end)
+{
+	return end->tv_sec - start->tv_sec + (double)(end->tv_usec - start->tv_usec) / 1000000;
+}
 
-	//Splits the workload by the number of threads
-#pragma omp parallel for num_threads(numberOfThreads)
-	for (int i = 0; i < numberOfThreads; i++)
+static void Print_Tlb_Misses(long long misses)
+{
+	if (misses >= 0)
+	{
+		printf("%lld dTLB misses\n", misses);
+	}
+	else
 	{
-		int sumOfThread = 0;
-		int startingLocationForThread = i * workloadPerThread;
+		printf("dTLB misses not counted\n");
+	}
+}
+
+// Times the serial and parallel sums with every kernel the CPU supports
+static void Benchmark_Kernels(const Numa_Array *numbers)
+{
+	struct timeval start, end;
+	const Sum_Kernel *selectedKernel = Active_Kernel;
 
-		for (long i = 0; i < workloadPerThread; i++)
+	printf("%-8s %12s %12s %12s %12s %14s\n", "kernel", "seq (s)", "par (s)", "seq GB/s", "par GB/s", "sum");
+
+	const Sum_Kernel *kernel;
+	for (int i = 0; (kernel = Sum_Kernel_Get(i)) != NULL; i++)
+	{
+		if (!kernel->is_supported())
 		{
-			sumOfThread += numbers[i + startingLocationForThread];
+			continue;
 		}
+		Active_Kernel = kernel;
+
+		gettimeofday(&start, NULL);
+		long sum_s = add_serial(numbers->data);
+		gettimeofday(&end, NULL);
+		double sequentialSeconds = Elapsed_Seconds(&start, &end);
+
+		gettimeofday(&start, NULL);
+		long sum_p = add_parallel(numbers);
+		gettimeofday(&end, NULL);
+		double parallelSeconds = Elapsed_Seconds(&start, &end);
+
+		printf("%-8s %12.6f %12.6f %12.2f %12.2f %14ld%s\n", kernel->name, sequentialSeconds, parallelSeconds,
+			   Num_To_Add / sequentialSeconds / 1e9, Num_To_Add / parallelSeconds / 1e9, sum_s,
+			   sum_s == sum_p ? "" : " (parallel sum differs)");
+	}
+
+	Active_Kernel = selectedKernel;
+}
+
+// Shows where the chunks' pages are and times the parallel sum once with every thread reading
+// its own chunk and once with as many threads as possible reading a chunk of another node
+static int Benchmark_Numa(Numa_Array *numbers)
+{
+	struct timeval start, end;
 
-		// Case for uneven division of workload
-		// Extra workload will be performed by last thread
-		if (extraWorkloadForLastThread > 0 && i == numberOfThreads - 1)
+	Numa_Array_Locate(numbers);
+	printf("%ld numbers in %d chunks on %d node(s), %s kernel\n\n", Num_To_Add, numbers->numberOfChunks,
+		   numbers->numberOfNodes, Active_Kernel->name);
+	Numa_Array_Print(numbers);
+
+	double remoteFraction;
+	int remoteShift = Numa_Array_Remote_Shift(numbers, &remoteFraction);
+
+	// The first pass faults in nothing new but warms the caches and the bindings for both
+	Numa_Array_Sum(numbers, Active_Kernel->sum, 0);
+
+	gettimeofday(&start, NULL);
+	long sum_local = Numa_Array_Sum(numbers, Active_Kernel->sum, 0);
+	gettimeofday(&end, NULL);
+	double localSeconds = Elapsed_Seconds(&start, &end);
+	printf("\nLocal:  %f seconds, %.2f GB/s\n", localSeconds, Num_To_Add / localSeconds / 1e9);
+
+	if (remoteShift == 0)
+	{
+		printf("Remote: every thread and chunk share one node, nothing to compare\n\n");
+		printf("Sum local: %ld", sum_local);
+		return 0;
+	}
+
+	gettimeofday(&start, NULL);
+	long sum_remote = Numa_Array_Sum(numbers, Active_Kernel->sum, remoteShift);
+	gettimeofday(&end, NULL);
+	double remoteSeconds = Elapsed_Seconds(&start, &end);
+	printf("Remote: %f seconds, %.2f GB/s (%.0f%% of the threads read another node)\n\n", remoteSeconds,
+		   Num_To_Add / remoteSeconds / 1e9, 100 * remoteFraction);
+
+	printf("Sum local: %ld\nSum remote: %ld", sum_local, sum_remote);
+	return sum_local == sum_remote ? 0 : 1;
+}
+
+// Times one pass over a file, cold with its pages dropped from the page cache first and then warm
+static int Sum_File(const char *path)
+{
+	struct timeval start, end;
+
+	Mapped_File file;
+	if (Mapped_File_Open(path, &file) != 0)
+	{
+		perror(path);
+		return 1;
+	}
+	printf("%zu numbers in %s, %d threads, %s kernel\n\n", file.length, path, omp_get_max_threads(), Active_Kernel->name);
+
+	const char *passNames[] = { "cold", "warm" };
+	long sums[2];
+	for (int pass = 0; pass < 2; pass++)
+	{
+		if (pass == 0)
+		{
+			Mapped_File_Drop_Cache(&file);
+		}
+		if (Mapped_File_Map(&file) != 0)
 		{
-			int startingLocationForExtraWorkload = startingLocationForThread + workloadPerThread;
-			for (long i = 0; i < extraWorkloadForLastThread; i++)
-			{
-				sumOfThread += numbers[i + startingLocationForExtraWorkload];
-			}
+			perror(path);
+			Mapped_File_Close(&file);
+			return 1;
 		}
 
-		// Sum the values calculated by each thread
-		totalSum += sumOfThread;
+		// Pages other processes hold or dirty pages can't be dropped, so says how cold the pass really is
+		printf("Timing %s pass (%.1f%% cached)...\n", passNames[pass], 100 * Mapped_File_Resident(&file));
+		gettimeofday(&start, NULL);
+		sums[pass] = Mapped_File_Sum(&file, Active_Kernel->sum);
+		gettimeofday(&end, NULL);
+		double seconds = Elapsed_Seconds(&start, &end);
+		printf("Took %f seconds, %.2f GB/s\n\n", seconds, file.length / seconds / 1e9);
+
+		Mapped_File_Unmap(&file);
+	}
+	Mapped_File_Close(&file);
+
+	printf("Sum cold: %ld\nSum warm: %ld", sums[0], sums[1]);
+	return sums[0] == sums[1] ? 0 : 1;
+}
+
+// Sums everything read from path ("-" for stdin) through the buffer ring, reading while summing
+static int Sum_Stream(const char *path, Stream_Reader reader)
+{
+	struct timeval start, end;
+
+	int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		perror(path);
+		return 1;
+	}
+
+	printf("Timing streamed sum of %s (%s kernel)...\n", path, Active_Kernel->name);
+	Stream_Result result;
+	gettimeofday(&start, NULL);
+	int status = Stream_Sum(fd, reader, Active_Kernel->sum, &result);
+	gettimeofday(&end, NULL);
+	double seconds = Elapsed_Seconds(&start, &end);
+	if (fd != STDIN_FILENO)
+	{
+		close(fd);
+	}
+	if (status != 0)
+	{
+		perror(path);
+		return 1;
 	}
 
-	return totalSum;
+	printf("Took %f seconds for %llu numbers, %.2f GB/s with the %s reader\n\n", seconds,
+		   (unsigned long long)result.bytes, result.bytes / seconds / 1e9, Stream_Reader_Name(result.reader));
+	printf("Sum streamed: %ld", result.sum);
+	return 0;
+}
+
+// Writes the generated numbers to path, as input for --file
+static int Write_Numbers(const char *path, const char *numbers)
+{
+	FILE *file = fopen(path, "wb");
+	if (file == NULL || fwrite(numbers, 1, Num_To_Add, file) != (size_t)Num_To_Add || fclose(file) != 0)
+	{
+		perror(path);
+		return 1;
+	}
+	printf("Wrote %ld numbers to %s", Num_To_Add, path);
+	return 0;
 }
 
-int main() {
-	char* numbers = malloc(sizeof(long) * Num_To_Add);
+static void Print_Usage(const char *program)
+{
+	printf("Usage: %s [options]\n"
+		   "  --kernel NAME summing kernel, defaults to the widest one this CPU supports\n"
+		   "  --bench-kernels\n"
+		   "                time the sequential and parallel sums with every kernel\n"
+		   "  --file PATH   sum the bytes of PATH through a read only mapping instead of the generated\n"
+		   "                numbers, once with the file dropped from the page cache and once cached\n"
+		   "  --stream PATH sum the bytes read from PATH, or stdin for -, while the next reads are\n"
+		   "                in flight; works on pipes and sockets as well as files\n"
+		   "  --reader NAME uring (default, falls back to threads where io_uring is unavailable)\n"
+		   "                or threads, how --stream reads\n"
+		   "  --generate PATH\n"
+		   "                write the generated numbers to PATH and exit\n"
+		   "  --pages KIND  largest pages to put the generated numbers on: 1g (default), 2m, thp or\n"
+		   "                normal; smaller ones are tried when those can't be had\n"
+		   "  --numa-bench  show which node holds each thread's chunk and time the parallel sum with\n"
+		   "                node local reads against reads from the other nodes\n"
+		   "\nKernels:\n",
+		   program);
+	Sum_Kernel_Print_All();
+}
+
+int main(int argc, char *argv[]) {
+	Active_Kernel = Sum_Kernel_Best();
+	int benchmarkKernels = 0;
+	int benchmarkNuma = 0;
+	const char *filePath = NULL;
+	const char *generatePath = NULL;
+	const char *streamPath = NULL;
+	int reader = STREAM_READER_URING;
+	int pages = HUGE_PAGE_1G;
+
+	static const struct option Long_Options[] = {
+		{ "kernel",        required_argument, NULL, 'k' },
+		{ "bench-kernels", no_argument,       NULL, 'B' },
+		{ "file",          required_argument, NULL, 'f' },
+		{ "generate",      required_argument, NULL, 'G' },
+		{ "stream",        required_argument, NULL, 'S' },
+		{ "reader",        required_argument, NULL, 'R' },
+		{ "numa-bench",    no_argument,       NULL, 'N' },
+		{ "pages",         required_argument, NULL, 'P' },
+		{ "help",          no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int option;
+	while ((option = getopt_long(argc, argv, "k:h", Long_Options, NULL)) != -1)
+	{
+		switch (option)
+		{
+			case 'k':
+				Active_Kernel = Sum_Kernel_Find(optarg);
+				if (Active_Kernel == NULL || !Active_Kernel->is_supported())
+				{
+					fprintf(stderr, "Kernel \"%s\" is unknown or not supported by this CPU\n", optarg);
+					return 1;
+				}
+				break;
+			case 'B':
+				benchmarkKernels = 1;
+				break;
+			case 'f':
+				filePath = optarg;
+				break;
+			case 'G':
+				generatePath = optarg;
+				break;
+			case 'S':
+				streamPath = optarg;
+				break;
+			case 'R':
+				reader = Stream_Reader_Find(optarg);
+				if (reader < 0)
+				{
+					fprintf(stderr, "Unknown reader \"%s\"\n", optarg);
+					return 1;
+				}
+				break;
+			case 'N':
+				benchmarkNuma = 1;
+				break;
+			case 'P':
+				pages = Huge_Page_Find(optarg);
+				if (pages < 0)
+				{
+					fprintf(stderr, "Unknown page kind \"%s\"\n", optarg);
+					return 1;
+				}
+				break;
+			case 'h':
+				Print_Usage(argv[0]);
+				return 0;
+			default:
+				Print_Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (filePath != NULL)
+	{
+		return Sum_File(filePath);
+	}
+
+	if (streamPath != NULL)
+	{
+		return Sum_Stream(streamPath, (Stream_Reader)reader);
+	}
+
+	if (Tlb_Counter_Open(&Tlb_Misses) != 0)
+	{
+		fprintf(stderr, "dTLB misses can't be counted: %s\n", strerror(errno));
+	}
+
+	Numa_Array numbers;
+	if (Numa_Array_Create(&numbers, Num_To_Add, omp_get_max_threads(), (Huge_Page_Kind)pages) != 0)
+	{
+		fprintf(stderr, "Could not allocate %ld numbers\n", Num_To_Add);
+		return 1;
+	}
 
-	long chunk_size = Num_To_Add / omp_get_max_threads();
-#pragma omp parallel num_threads(omp_get_max_threads())
+	// Each thread writes the chunk it will later sum, from the CPU it will sum it on, so the
+	// chunk's pages are first touched and therefore placed on that CPU's node
+#pragma omp parallel num_threads(numbers.numberOfChunks)
 	{
 		int p = omp_get_thread_num();
+		Numa_Bind_Thread(&numbers, p);
 		unsigned int seed = (unsigned int)time(NULL) + (unsigned int)p;
-		long chunk_start = p * chunk_size;
-		long chunk_end = chunk_start + chunk_size;
-		for (long i = chunk_start; i < chunk_end; i++) {
-			numbers[i] = (char)(rand_r(&seed) * Scale);
+		for (size_t i = numbers.chunks[p].begin; i < numbers.chunks[p].end; i++) {
+			numbers.data[i] = (char)(rand_r(&seed) * Scale);
 		}
 	}
 
+	printf("Numbers on %s pages, %.1f%% of them huge%s\n\n", Huge_Page_Name(numbers.memory.kind),
+		   100 * Huge_Buffer_Huge_Fraction(&numbers.memory),
+		   numbers.pagesCapped ? " (no larger, so no page spans chunks of two nodes)" : "");
+
+	if (generatePath != NULL)
+	{
+		int status = Write_Numbers(generatePath, numbers.data);
+		Numa_Array_Free(&numbers);
+		return status;
+	}
+
+	if (benchmarkKernels)
+	{
+		printf("%ld numbers, %d threads\n\n", Num_To_Add, omp_get_max_threads());
+		Benchmark_Kernels(&numbers);
+		Numa_Array_Free(&numbers);
+		return 0;
+	}
+
+	if (benchmarkNuma)
+	{
+		int status = Benchmark_Numa(&numbers);
+		Numa_Array_Free(&numbers);
+		return status;
+	}
+
 	struct timeval start, end;
 
-	printf("Timing sequential...\n");
+	printf("Timing sequential (%s kernel)...\n", Active_Kernel->name);
+	Tlb_Counter_Start(&Tlb_Misses);
 	gettimeofday(&start, NULL);
-	long sum_s = add_serial(numbers);
+	long sum_s = add_serial(numbers.data);
 	gettimeofday(&end, NULL);
-	printf("Took %f seconds\n\n", end.tv_sec - start.tv_sec + (double)(end.tv_usec - start.tv_usec) / 1000000);
+	long long tlbMisses = Tlb_Counter_Stop(&Tlb_Misses);
+	printf("Took %f seconds, ", Elapsed_Seconds(&start, &end));
+	Print_Tlb_Misses(tlbMisses);
+	printf("\n");
 
 	printf("Timing parallel...\n");
+	Tlb_Counter_Start(&Tlb_Misses);
 	gettimeofday(&start, NULL);
-	long sum_p = add_parallel(numbers);
+	long sum_p = add_parallel(&numbers);
 	gettimeofday(&end, NULL);
-	printf("Took %f seconds\n\n", end.tv_sec - start.tv_sec + (double)(end.tv_usec - start.tv_usec) / 1000000);
+	tlbMisses = Tlb_Counter_Stop(&Tlb_Misses);
+	printf("Took %f seconds, ", Elapsed_Seconds(&start, &end));
+	Print_Tlb_Misses(tlbMisses);
+	printf("\n");
 
 	printf("Sum serial: %ld\nSum parallel: %ld", sum_s, sum_p);
 
-	free(numbers);
+	Numa_Array_Free(&numbers);
+	Tlb_Counter_Close(&Tlb_Misses);
 	return 0;
 }
-
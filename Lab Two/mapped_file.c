@@ -0,0 +1,134 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "mapped_file.h"
+
+int Mapped_File_Open(const char *path, Mapped_File *file)
+{
+	file->data = NULL;
+	file->fd = open(path, O_RDONLY);
+	if (file->fd < 0)
+	{
+		return -1;
+	}
+
+	struct stat status;
+	if (fstat(file->fd, &status) != 0)
+	{
+		close(file->fd);
+		return -1;
+	}
+	file->length = (size_t)status.st_size;
+	return 0;
+}
+
+int Mapped_File_Map(Mapped_File *file)
+{
+	if (file->length == 0)
+	{
+		return 0;
+	}
+
+	void *data = mmap(NULL, file->length, PROT_READ, MAP_PRIVATE, file->fd, 0);
+	if (data == MAP_FAILED)
+	{
+		return -1;
+	}
+
+	// Advice only, a kernel that doesn't support it still maps the file
+	madvise(data, file->length, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+	madvise(data, file->length, MADV_HUGEPAGE);
+#endif
+
+	file->data = data;
+	return 0;
+}
+
+void Mapped_File_Drop_Cache(const Mapped_File *file)
+{
+	posix_fadvise(file->fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+double Mapped_File_Resident(const Mapped_File *file)
+{
+	if (file->data == NULL)
+	{
+		return 0;
+	}
+
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t pages = (file->length + pageSize - 1) / pageSize;
+	unsigned char *resident = malloc(pages);
+	if (resident == NULL || mincore((void *)file->data, file->length, resident) != 0)
+	{
+		free(resident);
+		return 0;
+	}
+
+	size_t residentPages = 0;
+	for (size_t i = 0; i < pages; i++)
+	{
+		residentPages += resident[i] & 1;
+	}
+	free(resident);
+	return (double)residentPages / pages;
+}
+
+long Mapped_File_Sum(const Mapped_File *file, Sum_Fn kernel)
+{
+	long totalSum = 0;
+	if (file->length == 0)
+	{
+		return 0;
+	}
+
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t pages = (file->length + pageSize - 1) / pageSize;
+	int numberOfThreads = omp_get_max_threads();
+
+	//Splits the file by the number of threads, on page boundaries so no page is faulted in by two threads
+#pragma omp parallel for num_threads(numberOfThreads) reduction(+:totalSum)
+	for (int i = 0; i < numberOfThreads; i++)
+	{
+		size_t begin = pages * i / numberOfThreads * pageSize;
+		size_t end = pages * (i + 1) / numberOfThreads * pageSize;
+		if (end > file->length)
+		{
+			end = file->length;
+		}
+
+		for (size_t window = begin; window < end; window += MAPPED_FILE_WINDOW)
+		{
+			size_t windowEnd = end - window < MAPPED_FILE_WINDOW ? end : window + MAPPED_FILE_WINDOW;
+			if (windowEnd < end)
+			{
+				size_t next = end - windowEnd < MAPPED_FILE_WINDOW ? end - windowEnd : MAPPED_FILE_WINDOW;
+				madvise((void *)(file->data + windowEnd), next, MADV_WILLNEED);
+			}
+			totalSum += kernel(file->data + window, windowEnd - window);
+		}
+	}
+
+	return totalSum;
+}
+
+void Mapped_File_Unmap(Mapped_File *file)
+{
+	if (file->data != NULL)
+	{
+		munmap((void *)file->data, file->length);
+		file->data = NULL;
+	}
+}
+
+void Mapped_File_Close(Mapped_File *file)
+{
+	Mapped_File_Unmap(file);
+	close(file->fd);
+}
@@ -0,0 +1,51 @@
+#ifndef LAB2_MAPPED_FILE_H
+#define LAB2_MAPPED_FILE_H
+
+#include <stddef.h>
+
+#include "sum_kernels.h"
+
+/*
+ * Summing a file of chars straight out of the page cache.
+ *
+ * The file is mapped read only, so the kernels read the cached pages
+ * themselves without copying them into a buffer first. The mapping is
+ * advised MADV_SEQUENTIAL (aggressive readahead, pages dropped soon after
+ * use) and MADV_HUGEPAGE (honoured where the kernel supports huge pages
+ * for file mappings, ignored otherwise).
+ *
+ * Each OpenMP thread sums one contiguous, page aligned share of the file.
+ * It walks its share in windows of MAPPED_FILE_WINDOW bytes and asks for
+ * the next window with MADV_WILLNEED before summing the current one, so
+ * every thread keeps its own readahead going instead of relying on the
+ * single stream the kernel would detect.
+ */
+
+#define MAPPED_FILE_WINDOW ((size_t)8 << 20)
+
+typedef struct Mapped_File {
+	int fd;
+	size_t length;
+	const char *data;
+} Mapped_File;
+
+// Opens path for reading, returns 0 on success and -1 with errno set otherwise
+int Mapped_File_Open(const char *path, Mapped_File *file);
+
+// Maps the whole file and applies the advice above, returns 0 on success and -1 with errno set otherwise
+int Mapped_File_Map(Mapped_File *file);
+
+// Asks the kernel to drop the file's clean pages from the page cache, so the next pass reads the device
+void Mapped_File_Drop_Cache(const Mapped_File *file);
+
+// Returns the fraction of the mapped file that is currently in the page cache
+double Mapped_File_Resident(const Mapped_File *file);
+
+// Sums the mapped file with kernel on the OpenMP threads
+long Mapped_File_Sum(const Mapped_File *file, Sum_Fn kernel);
+
+void Mapped_File_Unmap(Mapped_File *file);
+
+void Mapped_File_Close(Mapped_File *file);
+
+#endif //LAB2_MAPPED_FILE_H
@@ -0,0 +1,275 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "numa_array.h"
+
+// Pages whose node is asked for with one move_pages call
+static const size_t Locate_Batch = 4096;
+
+// CPU the calling thread is bound to, -1 while it may run anywhere
+static _Thread_local int Bound_Cpu = -1;
+
+// The node of a CPU is the nodeN link in its sysfs directory, node 0 without NUMA support
+static int Cpu_Node(int cpu)
+{
+	char path[128];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	DIR *directory = opendir(path);
+	if (directory == NULL)
+	{
+		return 0;
+	}
+
+	int node = 0;
+	struct dirent *entry;
+	while ((entry = readdir(directory)) != NULL)
+	{
+		if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+		{
+			node = atoi(entry->d_name + 4);
+			break;
+		}
+	}
+	closedir(directory);
+	return node;
+}
+
+// Orders the allowed CPUs so consecutive entries go round robin over the nodes
+static int Spread_Cpus(int *cpus, int *nodes, int *number_of_nodes)
+{
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+	{
+		CPU_SET(0, &allowed);
+	}
+
+	int numberOfCpus = 0, maxNode = 0;
+	int *allCpus = malloc(CPU_SETSIZE * sizeof(int));
+	int *allNodes = malloc(CPU_SETSIZE * sizeof(int));
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if (CPU_ISSET(cpu, &allowed))
+		{
+			allCpus[numberOfCpus] = cpu;
+			allNodes[numberOfCpus] = Cpu_Node(cpu);
+			if (allNodes[numberOfCpus] > maxNode)
+			{
+				maxNode = allNodes[numberOfCpus];
+			}
+			numberOfCpus++;
+		}
+	}
+
+	// Rank of every CPU among the CPUs of its node
+	int *rank = calloc((size_t)numberOfCpus, sizeof(int));
+	*number_of_nodes = 0;
+	for (int i = 0; i < numberOfCpus; i++)
+	{
+		for (int j = 0; j < i; j++)
+		{
+			rank[i] += allNodes[j] == allNodes[i];
+		}
+		*number_of_nodes += rank[i] == 0;
+	}
+
+	// The first CPU of every node, then the second one of every node...
+	int placed = 0;
+	for (int round = 0; placed < numberOfCpus; round++)
+	{
+		for (int node = 0; node <= maxNode; node++)
+		{
+			for (int i = 0; i < numberOfCpus; i++)
+			{
+				if (allNodes[i] == node && rank[i] == round)
+				{
+					cpus[placed] = allCpus[i];
+					nodes[placed] = node;
+					placed++;
+				}
+			}
+		}
+	}
+
+	free(rank);
+	free(allCpus);
+	free(allNodes);
+	return numberOfCpus;
+}
+
+int Numa_Array_Create(Numa_Array *array, size_t length, int number_of_threads, Huge_Page_Kind largest)
+{
+	memset(array, 0, sizeof(*array));
+
+	int *cpus = malloc(CPU_SETSIZE * sizeof(int));
+	int *nodes = malloc(CPU_SETSIZE * sizeof(int));
+	int numberOfCpus = Spread_Cpus(cpus, nodes, &array->numberOfNodes);
+
+	int spansNodes = 0;
+	for (int i = 1; i < number_of_threads; i++)
+	{
+		spansNodes |= nodes[i % numberOfCpus] != nodes[0];
+	}
+
+	// A page larger than a chunk would be first touched, and so placed, by one chunk's thread only
+	Huge_Page_Kind kind = largest;
+	while (spansNodes && kind < HUGE_PAGE_NORMAL && Huge_Page_Size(kind) > length / number_of_threads)
+	{
+		kind++;
+	}
+	if (Huge_Buffer_Alloc(&array->memory, length, kind) != 0)
+	{
+		free(cpus);
+		free(nodes);
+		return -1;
+	}
+	// Chunks that all share one node may split pages, they land on the right node either way
+	size_t pageSize = spansNodes ? Huge_Page_Size(array->memory.kind) : 1;
+
+	array->data = array->memory.data;
+	array->length = length;
+	array->pagesCapped = kind != largest;
+	array->numberOfChunks = number_of_threads;
+	array->chunks = calloc((size_t)number_of_threads, sizeof(Numa_Chunk));
+	for (int i = 0; i < number_of_threads; i++)
+	{
+		Numa_Chunk *chunk = &array->chunks[i];
+		// Even shares rounded down to whole pages, the last chunk takes the rest
+		chunk->begin = length * i / number_of_threads / pageSize * pageSize;
+		chunk->end = i == number_of_threads - 1 ? length : length * (i + 1) / number_of_threads / pageSize * pageSize;
+		chunk->cpu = cpus[i % numberOfCpus];
+		chunk->node = nodes[i % numberOfCpus];
+		chunk->localFraction = -1;
+	}
+
+	free(cpus);
+	free(nodes);
+	return 0;
+}
+
+void Numa_Bind_Thread(const Numa_Array *array, int thread)
+{
+	int cpu = array->chunks[thread].cpu;
+	if (cpu == Bound_Cpu)
+	{
+		return;
+	}
+
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	Bound_Cpu = cpu;
+}
+
+void Numa_Array_Locate(Numa_Array *array)
+{
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	void **pages = malloc(Locate_Batch * sizeof(void *));
+	int *status = malloc(Locate_Batch * sizeof(int));
+
+	for (int i = 0; i < array->numberOfChunks; i++)
+	{
+		Numa_Chunk *chunk = &array->chunks[i];
+		// Pages shared with the neighbouring chunks are left out
+		size_t first = (chunk->begin + pageSize - 1) / pageSize, last = chunk->end / pageSize;
+		size_t located = 0, local = 0;
+
+		for (size_t page = first; page < last; page += Locate_Batch)
+		{
+			size_t count = last - page < Locate_Batch ? last - page : Locate_Batch;
+			for (size_t j = 0; j < count; j++)
+			{
+				pages[j] = array->data + (page + j) * pageSize;
+			}
+
+			// Without target nodes move_pages only reports where each page is
+			if (syscall(SYS_move_pages, 0, count, pages, NULL, status, 0) != 0)
+			{
+				located = 0;
+				break;
+			}
+			for (size_t j = 0; j < count; j++)
+			{
+				located += status[j] >= 0;
+				local += status[j] == chunk->node;
+			}
+		}
+
+		chunk->localFraction = located > 0 ? (double)local / located : -1;
+	}
+
+	free(pages);
+	free(status);
+}
+
+void Numa_Array_Print(const Numa_Array *array)
+{
+	printf("%-8s %14s %14s %6s %6s %8s\n", "chunk", "begin", "end", "cpu", "node", "local %");
+	for (int i = 0; i < array->numberOfChunks; i++)
+	{
+		const Numa_Chunk *chunk = &array->chunks[i];
+		printf("%-8d %14zu %14zu %6d %6d", i, chunk->begin, chunk->end, chunk->cpu, chunk->node);
+		if (chunk->localFraction >= 0)
+		{
+			printf(" %8.1f\n", 100 * chunk->localFraction);
+		}
+		else
+		{
+			printf(" %8s\n", "?");
+		}
+	}
+}
+
+long Numa_Array_Sum(const Numa_Array *array, Sum_Fn kernel, int shift)
+{
+	long totalSum = 0;
+
+	//Every thread sums one chunk, its own unless shifted
+#pragma omp parallel for num_threads(array->numberOfChunks) reduction(+:totalSum)
+	for (int i = 0; i < array->numberOfChunks; i++)
+	{
+		Numa_Bind_Thread(array, i);
+		const Numa_Chunk *chunk = &array->chunks[(i + shift) % array->numberOfChunks];
+		totalSum += kernel(array->data + chunk->begin, chunk->end - chunk->begin);
+	}
+
+	return totalSum;
+}
+
+int Numa_Array_Remote_Shift(const Numa_Array *array, double *remote_fraction)
+{
+	int bestShift = 0, bestRemote = 0;
+	for (int shift = 1; shift < array->numberOfChunks; shift++)
+	{
+		int remote = 0;
+		for (int i = 0; i < array->numberOfChunks; i++)
+		{
+			remote += array->chunks[(i + shift) % array->numberOfChunks].node != array->chunks[i].node;
+		}
+		if (remote > bestRemote)
+		{
+			bestShift = shift;
+			bestRemote = remote;
+		}
+	}
+
+	*remote_fraction = (double)bestRemote / array->numberOfChunks;
+	return bestShift;
+}
+
+void Numa_Array_Free(Numa_Array *array)
+{
+	Huge_Buffer_Free(&array->memory);
+	free(array->chunks);
+	array->data = NULL;
+	array->chunks = NULL;
+}
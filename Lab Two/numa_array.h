@@ -0,0 +1,73 @@
+#ifndef LAB2_NUMA_ARRAY_H
+#define LAB2_NUMA_ARRAY_H
+
+#include <stddef.h>
+
+#include "sum_kernels.h"
+#include "huge_pages.h"
+
+/*
+ * An array split into one contiguous chunk per OpenMP thread, where every
+ * chunk lives on the NUMA node of the thread that works on it.
+ *
+ * Thread i is bound to one CPU, taking the CPUs of the nodes in turn so a
+ * team smaller than the machine still uses every node's memory controller.
+ * The array is reserved with Huge_Buffer_Alloc but not touched; each thread binds itself
+ * and then writes its own chunk first, and Linux's first touch policy puts
+ * those pages on the thread's node. As long as the threads that read the
+ * array use the same chunks and bindings, every read is node local.
+ *
+ * A page is placed as a whole, so when the chunks belong to more than one
+ * node the chunk boundaries are rounded to whole pages, and pages larger
+ * than a chunk (a 1 GiB page holds the whole default array) are not used;
+ * the largest kind of page that fits a chunk is taken instead.
+ *
+ * The node of the CPU each chunk was meant for is recorded when the array is
+ * created; Numa_Array_Locate asks the kernel (move_pages) where the pages
+ * actually ended up.
+ */
+
+typedef struct Numa_Chunk {
+	size_t begin;
+	size_t end;
+	// CPU the chunk's thread is bound to and its node
+	int cpu;
+	int node;
+	// Fraction of the chunk's pages found on node, -1 until located or if the kernel can't tell
+	double localFraction;
+} Numa_Chunk;
+
+typedef struct Numa_Array {
+	char *data;
+	Huge_Buffer memory;
+	size_t length;
+	int numberOfChunks;
+	int numberOfNodes;
+	// Set when smaller pages than asked for were used to keep every page within one node's chunk
+	int pagesCapped;
+	Numa_Chunk *chunks;
+} Numa_Array;
+
+// Reserves length bytes on pages no larger than largest or, if the chunks
+// belong to several nodes, than a chunk, split into number_of_threads chunks.
+// Returns 0 on success and -1 with errno set otherwise. No page is touched yet
+int Numa_Array_Create(Numa_Array *array, size_t length, int number_of_threads, Huge_Page_Kind largest);
+
+// Binds the calling thread to the CPU of chunk thread, cheap when it already is
+void Numa_Bind_Thread(const Numa_Array *array, int thread);
+
+// Fills in the local fraction of every chunk
+void Numa_Array_Locate(Numa_Array *array);
+
+// Writes one line per chunk with its range, CPU, node and local fraction
+void Numa_Array_Print(const Numa_Array *array);
+
+// Sums the array on its threads, thread i reading chunk (i + shift) % chunks
+long Numa_Array_Sum(const Numa_Array *array, Sum_Fn kernel, int shift);
+
+// Returns the shift for Numa_Array_Sum under which the most threads read a chunk of another node, 0 if there is none
+int Numa_Array_Remote_Shift(const Numa_Array *array, double *remote_fraction);
+
+void Numa_Array_Free(Numa_Array *array);
+
+#endif //LAB2_NUMA_ARRAY_H
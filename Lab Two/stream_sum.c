@@ -0,0 +1,599 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <omp.h>
+
+#include "stream_sum.h"
+
+static const char *Reader_Names[STREAM_NUMBER_OF_READERS] = { "uring", "threads" };
+
+static const size_t Buffer_Alignment = 4096;
+
+typedef struct Stream_Buffer {
+	char *data;
+	// Where the read started (regular files only), how much it asked for and how much arrived
+	uint64_t offset;
+	size_t wanted;
+	size_t length;
+} Stream_Buffer;
+
+typedef struct Stream_State {
+	int fd;
+	int seekable;
+	uint64_t size;
+	Stream_Buffer buffers[STREAM_BUFFERS];
+
+	pthread_mutex_t lock;
+	pthread_cond_t filledChanged;
+	pthread_cond_t freeChanged;
+	// Filled buffers waiting to be summed, in a ring, and free buffers waiting for a read
+	int filled[STREAM_BUFFERS];
+	int filledHead;
+	int filledCount;
+	int free[STREAM_BUFFERS];
+	int freeCount;
+
+	// Next range of a regular file to read
+	uint64_t nextOffset;
+	// Set once the end of the input was seen or a read failed, no new reads are started then
+	int exhausted;
+	// Set once no buffer will be filled any more
+	int finished;
+	int error;
+	uint64_t bytes;
+	int activeReaders;
+} Stream_State;
+
+int Stream_Reader_Find(const char *name)
+{
+	for (int i = 0; i < STREAM_NUMBER_OF_READERS; i++)
+	{
+		if (strcmp(Reader_Names[i], name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+const char *Stream_Reader_Name(Stream_Reader reader)
+{
+	return Reader_Names[reader];
+}
+
+/* -------------------------------------------------------- Buffer queues --- */
+
+// Returns a free buffer, or -1 if there is none and wait is not set or no read will be started any more
+static int Take_Free(Stream_State *state, int wait)
+{
+	pthread_mutex_lock(&state->lock);
+	while (wait && state->freeCount == 0 && !state->exhausted)
+	{
+		pthread_cond_wait(&state->freeChanged, &state->lock);
+	}
+	int buffer = state->freeCount > 0 && !state->exhausted ? state->free[--state->freeCount] : -1;
+	pthread_mutex_unlock(&state->lock);
+	return buffer;
+}
+
+static void Release_Buffer(Stream_State *state, int buffer)
+{
+	pthread_mutex_lock(&state->lock);
+	state->free[state->freeCount++] = buffer;
+	pthread_cond_signal(&state->freeChanged);
+	pthread_mutex_unlock(&state->lock);
+}
+
+// Hands a buffer to the summing threads, or back to the free ones if nothing arrived
+static void Push_Filled(Stream_State *state, int buffer)
+{
+	if (state->buffers[buffer].length == 0)
+	{
+		Release_Buffer(state, buffer);
+		return;
+	}
+
+	pthread_mutex_lock(&state->lock);
+	state->filled[(state->filledHead + state->filledCount++) % STREAM_BUFFERS] = buffer;
+	state->bytes += state->buffers[buffer].length;
+	pthread_cond_signal(&state->filledChanged);
+	pthread_mutex_unlock(&state->lock);
+}
+
+// Returns the next filled buffer, or -1 once every filled buffer has been taken and no more will come
+static int Take_Filled(Stream_State *state)
+{
+	pthread_mutex_lock(&state->lock);
+	while (state->filledCount == 0 && !state->finished)
+	{
+		pthread_cond_wait(&state->filledChanged, &state->lock);
+	}
+	int buffer = -1;
+	if (state->filledCount > 0)
+	{
+		buffer = state->filled[state->filledHead];
+		state->filledHead = (state->filledHead + 1) % STREAM_BUFFERS;
+		state->filledCount--;
+	}
+	pthread_mutex_unlock(&state->lock);
+	return buffer;
+}
+
+// Picks what the next read into buffer asks for, returns 0 once there is nothing left to read
+static int Claim_Range(Stream_State *state, int buffer)
+{
+	Stream_Buffer *target = &state->buffers[buffer];
+	pthread_mutex_lock(&state->lock);
+	int claimed = !state->exhausted;
+	if (claimed && state->seekable)
+	{
+		if (state->nextOffset >= state->size)
+		{
+			state->exhausted = 1;
+			pthread_cond_broadcast(&state->freeChanged);
+			claimed = 0;
+		}
+		else
+		{
+			target->offset = state->nextOffset;
+			target->wanted = state->size - state->nextOffset < STREAM_BUFFER_SIZE
+				? (size_t)(state->size - state->nextOffset) : STREAM_BUFFER_SIZE;
+			state->nextOffset += target->wanted;
+		}
+	}
+	else if (claimed)
+	{
+		target->wanted = STREAM_BUFFER_SIZE;
+	}
+	target->length = 0;
+	pthread_mutex_unlock(&state->lock);
+	return claimed;
+}
+
+static void Mark_Exhausted(Stream_State *state, int error)
+{
+	pthread_mutex_lock(&state->lock);
+	state->exhausted = 1;
+	if (error != 0 && state->error == 0)
+	{
+		state->error = error;
+	}
+	pthread_cond_broadcast(&state->freeChanged);
+	pthread_mutex_unlock(&state->lock);
+}
+
+static void Mark_Finished(Stream_State *state)
+{
+	pthread_mutex_lock(&state->lock);
+	state->finished = 1;
+	pthread_cond_broadcast(&state->filledChanged);
+	pthread_mutex_unlock(&state->lock);
+}
+
+/* ---------------------------------------------------------------- Threads --- */
+
+static void *Reader_Thread(void *argument)
+{
+	Stream_State *state = argument;
+
+	int buffer;
+	while ((buffer = Take_Free(state, 1)) >= 0)
+	{
+		if (!Claim_Range(state, buffer))
+		{
+			Release_Buffer(state, buffer);
+			break;
+		}
+
+		Stream_Buffer *target = &state->buffers[buffer];
+		while (target->length < target->wanted)
+		{
+			ssize_t bytes = state->seekable
+				? pread(state->fd, target->data + target->length, target->wanted - target->length,
+						(off_t)(target->offset + target->length))
+				: read(state->fd, target->data + target->length, target->wanted - target->length);
+			if (bytes < 0 && (errno == EINTR || errno == EAGAIN))
+			{
+				continue;
+			}
+			if (bytes <= 0)
+			{
+				Mark_Exhausted(state, bytes < 0 ? errno : 0);
+				break;
+			}
+			target->length += (size_t)bytes;
+		}
+		Push_Filled(state, buffer);
+	}
+
+	pthread_mutex_lock(&state->lock);
+	int last = --state->activeReaders == 0;
+	pthread_mutex_unlock(&state->lock);
+	if (last)
+	{
+		Mark_Finished(state);
+	}
+	return NULL;
+}
+
+/* --------------------------------------------------------------- io_uring --- */
+
+typedef struct Uring {
+	int fd;
+	unsigned *sqTail;
+	unsigned *sqMask;
+	unsigned *sqArray;
+	struct io_uring_sqe *sqes;
+	unsigned *cqHead;
+	unsigned *cqTail;
+	unsigned *cqMask;
+	struct io_uring_cqe *cqes;
+	void *sqRing;
+	size_t sqRingSize;
+	void *cqRing;
+	size_t cqRingSize;
+	size_t sqesSize;
+	unsigned toSubmit;
+	// Buffers with a read queued or in flight
+	unsigned char reading[STREAM_BUFFERS];
+} Uring;
+
+typedef struct Uring_Reader {
+	Uring ring;
+	Stream_State *state;
+	// Set when reads may still be in flight after the reader gave up, the
+	// ring and the buffers must then stay around for the kernel to write into
+	int abandoned;
+} Uring_Reader;
+
+// user_data of the cancel requests, told apart from the buffer numbers of the reads
+static const uint64_t Cancel_Tag = UINT64_MAX;
+
+static int Uring_Setup(Uring *ring, unsigned entries)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	memset(ring, 0, sizeof(*ring));
+
+	ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->fd < 0)
+	{
+		return -1;
+	}
+
+	ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	// Newer kernels map both rings with one call
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		ring->sqRingSize = ring->cqRingSize = ring->sqRingSize > ring->cqRingSize ? ring->sqRingSize : ring->cqRingSize;
+	}
+
+	ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sqRing == MAP_FAILED)
+	{
+		close(ring->fd);
+		return -1;
+	}
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		ring->cqRing = ring->sqRing;
+	}
+	else
+	{
+		ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cqRing == MAP_FAILED)
+		{
+			munmap(ring->sqRing, ring->sqRingSize);
+			close(ring->fd);
+			return -1;
+		}
+	}
+
+	ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+	{
+		if (ring->cqRing != ring->sqRing)
+		{
+			munmap(ring->cqRing, ring->cqRingSize);
+		}
+		munmap(ring->sqRing, ring->sqRingSize);
+		close(ring->fd);
+		return -1;
+	}
+
+	char *sq = ring->sqRing, *cq = ring->cqRing;
+	ring->sqTail = (unsigned *)(sq + params.sq_off.tail);
+	ring->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+	ring->sqArray = (unsigned *)(sq + params.sq_off.array);
+	ring->cqHead = (unsigned *)(cq + params.cq_off.head);
+	ring->cqTail = (unsigned *)(cq + params.cq_off.tail);
+	ring->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+	return 0;
+}
+
+static void Uring_Close(Uring *ring)
+{
+	munmap(ring->sqes, ring->sqesSize);
+	if (ring->cqRing != ring->sqRing)
+	{
+		munmap(ring->cqRing, ring->cqRingSize);
+	}
+	munmap(ring->sqRing, ring->sqRingSize);
+	close(ring->fd);
+}
+
+// Queues a read of the rest of buffer, submitted by the next Uring_Enter.
+// The ring has two entries for every buffer, so there is always room for a
+// read and a cancel request per buffer
+static void Uring_Queue_Read(Uring *ring, Stream_State *state, int buffer)
+{
+	Stream_Buffer *target = &state->buffers[buffer];
+	unsigned tail = *ring->sqTail;
+	unsigned index = tail & *ring->sqMask;
+
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = state->fd;
+	sqe->addr = (uint64_t)(uintptr_t)(target->data + target->length);
+	sqe->len = (uint32_t)(target->wanted - target->length);
+	// -1 reads from the current position of pipes and other streams
+	sqe->off = state->seekable ? target->offset + target->length : (uint64_t)-1;
+	sqe->user_data = (uint64_t)buffer;
+
+	ring->sqArray[index] = index;
+	atomic_store_explicit((_Atomic unsigned *)ring->sqTail, tail + 1, memory_order_release);
+	ring->toSubmit++;
+	ring->reading[buffer] = 1;
+}
+
+// Queues a request cancelling the read into buffer
+static void Uring_Queue_Cancel(Uring *ring, int buffer)
+{
+	unsigned tail = *ring->sqTail;
+	unsigned index = tail & *ring->sqMask;
+
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (uint64_t)buffer;
+	sqe->user_data = Cancel_Tag;
+
+	ring->sqArray[index] = index;
+	atomic_store_explicit((_Atomic unsigned *)ring->sqTail, tail + 1, memory_order_release);
+	ring->toSubmit++;
+}
+
+// Submits the queued reads and waits for at least one completion
+static int Uring_Enter(Uring *ring)
+{
+	for (;;)
+	{
+		long submitted = syscall(__NR_io_uring_enter, ring->fd, ring->toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		if (submitted >= 0)
+		{
+			ring->toSubmit -= (unsigned)submitted;
+			return 0;
+		}
+		if (errno != EINTR)
+		{
+			return -1;
+		}
+	}
+}
+
+// Cancels every read still queued or in flight and reaps them all, so the
+// kernel is done with the buffers. Returns -1 if the ring failed before it
+// could confirm that
+static int Uring_Cancel_All(Uring *ring, int in_flight)
+{
+	for (int buffer = 0; buffer < STREAM_BUFFERS; buffer++)
+	{
+		if (ring->reading[buffer])
+		{
+			Uring_Queue_Cancel(ring, buffer);
+		}
+	}
+
+	while (in_flight > 0)
+	{
+		if (Uring_Enter(ring) != 0)
+		{
+			return -1;
+		}
+
+		unsigned head = *ring->cqHead;
+		unsigned tail = atomic_load_explicit((_Atomic unsigned *)ring->cqTail, memory_order_acquire);
+		for (; head != tail; head++)
+		{
+			const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+			if (cqe->user_data != Cancel_Tag)
+			{
+				ring->reading[cqe->user_data] = 0;
+				in_flight--;
+			}
+		}
+		atomic_store_explicit((_Atomic unsigned *)ring->cqHead, head, memory_order_release);
+	}
+	return 0;
+}
+
+static void *Uring_Thread(void *argument)
+{
+	Uring_Reader *reader = argument;
+	Uring *ring = &reader->ring;
+	Stream_State *state = reader->state;
+	int inFlight = 0;
+
+	for (;;)
+	{
+		// Start a read into every free buffer while there is input left
+		int buffer;
+		while ((buffer = Take_Free(state, inFlight == 0)) >= 0)
+		{
+			if (!Claim_Range(state, buffer))
+			{
+				Release_Buffer(state, buffer);
+				break;
+			}
+			Uring_Queue_Read(ring, state, buffer);
+			inFlight++;
+		}
+		if (inFlight == 0)
+		{
+			break;
+		}
+
+		if (Uring_Enter(ring) != 0)
+		{
+			// Closing the ring doesn't wait for the reads it cancels, so they are cancelled and reaped here
+			Mark_Exhausted(state, errno);
+			reader->abandoned = Uring_Cancel_All(ring, inFlight) != 0;
+			break;
+		}
+
+		unsigned head = *ring->cqHead;
+		unsigned tail = atomic_load_explicit((_Atomic unsigned *)ring->cqTail, memory_order_acquire);
+		for (; head != tail; head++)
+		{
+			const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+			int completed = (int)cqe->user_data;
+			Stream_Buffer *target = &state->buffers[completed];
+			ring->reading[completed] = 0;
+			inFlight--;
+
+			if (cqe->res == -EINTR || cqe->res == -EAGAIN)
+			{
+				Uring_Queue_Read(ring, state, completed);
+				inFlight++;
+				continue;
+			}
+			if (cqe->res <= 0)
+			{
+				Mark_Exhausted(state, -cqe->res);
+				Push_Filled(state, completed);
+				continue;
+			}
+
+			// A short read is continued into the rest of the buffer
+			target->length += (size_t)cqe->res;
+			if (target->length < target->wanted)
+			{
+				Uring_Queue_Read(ring, state, completed);
+				inFlight++;
+			}
+			else
+			{
+				Push_Filled(state, completed);
+			}
+		}
+		atomic_store_explicit((_Atomic unsigned *)ring->cqHead, head, memory_order_release);
+	}
+
+	Mark_Finished(state);
+	return NULL;
+}
+
+/* ----------------------------------------------------------------- Driver --- */
+
+int Stream_Sum(int fd, Stream_Reader reader, Sum_Fn kernel, Stream_Result *result)
+{
+	Stream_State *state = calloc(1, sizeof(Stream_State));
+	state->fd = fd;
+
+	struct stat status;
+	if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode))
+	{
+		state->seekable = 1;
+		state->size = (uint64_t)status.st_size;
+	}
+
+	pthread_mutex_init(&state->lock, NULL);
+	pthread_cond_init(&state->filledChanged, NULL);
+	pthread_cond_init(&state->freeChanged, NULL);
+	for (int i = 0; i < STREAM_BUFFERS; i++)
+	{
+		state->buffers[i].data = aligned_alloc(Buffer_Alignment, STREAM_BUFFER_SIZE);
+		state->free[state->freeCount++] = STREAM_BUFFERS - 1 - i;
+	}
+
+	Uring_Reader uring;
+	uring.state = state;
+	uring.abandoned = 0;
+	if (reader == STREAM_READER_URING && Uring_Setup(&uring.ring, 2 * STREAM_BUFFERS) != 0)
+	{
+		reader = STREAM_READER_THREADS;
+	}
+
+	int numberOfReaders = reader == STREAM_READER_URING ? 1 : STREAM_READING_THREADS;
+	pthread_t readers[STREAM_READING_THREADS];
+	state->activeReaders = numberOfReaders;
+	for (int i = 0; i < numberOfReaders; i++)
+	{
+		if (reader == STREAM_READER_URING)
+		{
+			pthread_create(&readers[i], NULL, Uring_Thread, &uring);
+		}
+		else
+		{
+			pthread_create(&readers[i], NULL, Reader_Thread, state);
+		}
+	}
+
+	long totalSum = 0;
+
+	//Every thread sums whichever buffer is filled next
+#pragma omp parallel num_threads(omp_get_max_threads()) reduction(+:totalSum)
+	{
+		int buffer;
+		while ((buffer = Take_Filled(state)) >= 0)
+		{
+			totalSum += kernel(state->buffers[buffer].data, state->buffers[buffer].length);
+			Release_Buffer(state, buffer);
+		}
+	}
+
+	for (int i = 0; i < numberOfReaders; i++)
+	{
+		pthread_join(readers[i], NULL);
+	}
+	// Buffers the kernel may still write into are left allocated, a leak is the lesser evil
+	int buffersInUse = reader == STREAM_READER_URING && uring.abandoned;
+	if (reader == STREAM_READER_URING && !buffersInUse)
+	{
+		Uring_Close(&uring.ring);
+	}
+
+	result->sum = totalSum;
+	result->bytes = state->bytes;
+	result->reader = reader;
+	int error = state->error;
+
+	for (int i = 0; i < STREAM_BUFFERS && !buffersInUse; i++)
+	{
+		free(state->buffers[i].data);
+	}
+	pthread_mutex_destroy(&state->lock);
+	pthread_cond_destroy(&state->filledChanged);
+	pthread_cond_destroy(&state->freeChanged);
+	free(state);
+
+	if (error != 0)
+	{
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
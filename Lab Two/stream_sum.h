@@ -0,0 +1,59 @@
+#ifndef LAB2_STREAM_SUM_H
+#define LAB2_STREAM_SUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sum_kernels.h"
+
+/*
+ * Summing input that can't be mapped: pipes, sockets, stdin, or files read
+ * without mmap.
+ *
+ * The data passes through a ring of STREAM_BUFFERS page aligned buffers of
+ * STREAM_BUFFER_SIZE bytes. Reads are issued into every free buffer, and the
+ * OpenMP threads sum each buffer as soon as it is filled and hand it back for
+ * the next read. The device keeps reading while the threads are summing, so
+ * the slower of the two sets the pace instead of their sum. Since addition
+ * doesn't care about order, buffers may be filled and summed in any order.
+ *
+ * The readers are
+ *
+ *   uring    one thread submitting the reads to an io_uring (set up with the
+ *            raw system calls) and reaping their completions, so every
+ *            buffer can have a read in flight at the same time
+ *   threads  STREAM_READING_THREADS threads each doing blocking reads, the
+ *            fallback where io_uring is missing or forbidden
+ *
+ * Regular files are read at explicit offsets, one buffer sized range per
+ * read, so the reads proceed in parallel. Other inputs are read from their
+ * current position; a short read is continued into the rest of its buffer.
+ */
+
+#define STREAM_BUFFERS 16
+#define STREAM_BUFFER_SIZE ((size_t)1 << 20)
+#define STREAM_READING_THREADS 4
+
+typedef enum Stream_Reader {
+	STREAM_READER_URING,
+	STREAM_READER_THREADS,
+	STREAM_NUMBER_OF_READERS
+} Stream_Reader;
+
+typedef struct Stream_Result {
+	long sum;
+	uint64_t bytes;
+	// The reader that actually ran, threads if io_uring could not be set up
+	Stream_Reader reader;
+} Stream_Result;
+
+// Returns the reader with the given name, or -1 if there is no such reader
+int Stream_Reader_Find(const char *name);
+
+const char *Stream_Reader_Name(Stream_Reader reader);
+
+// Sums every byte that can be read from fd until its end with kernel.
+// Returns 0 on success and -1 with errno set if a read failed
+int Stream_Sum(int fd, Stream_Reader reader, Sum_Fn kernel, Stream_Result *result);
+
+#endif //LAB2_STREAM_SUM_H
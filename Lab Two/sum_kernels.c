@@ -0,0 +1,163 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "sum_kernels.h"
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512BW __attribute__((target("avx512f,avx512bw")))
+
+// Added to every byte by flipping its top bit, see sum_kernels.h
+static const long Byte_Bias = 128;
+
+static int Always_Supported(void)
+{
+	return 1;
+}
+
+static long Sum_Scalar(const char *numbers, size_t count)
+{
+	long sum = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		sum += numbers[i];
+	}
+	return sum;
+}
+
+/* ---------------------------------------------------------------- SSE2 --- */
+
+static long Sum_Sse2(const char *numbers, size_t count)
+{
+	const __m128i flip = _mm_set1_epi8((char)0x80);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum0 = zero, sum1 = zero, sum2 = zero, sum3 = zero;
+
+	size_t i = 0;
+	for (; i + 64 <= count; i += 64)
+	{
+		const __m128i *block = (const __m128i *)(numbers + i);
+		sum0 = _mm_add_epi64(sum0, _mm_sad_epu8(_mm_xor_si128(_mm_loadu_si128(block + 0), flip), zero));
+		sum1 = _mm_add_epi64(sum1, _mm_sad_epu8(_mm_xor_si128(_mm_loadu_si128(block + 1), flip), zero));
+		sum2 = _mm_add_epi64(sum2, _mm_sad_epu8(_mm_xor_si128(_mm_loadu_si128(block + 2), flip), zero));
+		sum3 = _mm_add_epi64(sum3, _mm_sad_epu8(_mm_xor_si128(_mm_loadu_si128(block + 3), flip), zero));
+	}
+
+	__m128i sum = _mm_add_epi64(_mm_add_epi64(sum0, sum1), _mm_add_epi64(sum2, sum3));
+	uint64_t lanes[2];
+	_mm_storeu_si128((__m128i *)lanes, sum);
+
+	return (long)(lanes[0] + lanes[1]) - Byte_Bias * (long)i + Sum_Scalar(numbers + i, count - i);
+}
+
+/* ---------------------------------------------------------------- AVX2 --- */
+
+static int Avx2_Supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+TARGET_AVX2
+static long Sum_Avx2(const char *numbers, size_t count)
+{
+	const __m256i flip = _mm256_set1_epi8((char)0x80);
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i sum0 = zero, sum1 = zero, sum2 = zero, sum3 = zero;
+
+	size_t i = 0;
+	for (; i + 128 <= count; i += 128)
+	{
+		const __m256i *block = (const __m256i *)(numbers + i);
+		sum0 = _mm256_add_epi64(sum0, _mm256_sad_epu8(_mm256_xor_si256(_mm256_loadu_si256(block + 0), flip), zero));
+		sum1 = _mm256_add_epi64(sum1, _mm256_sad_epu8(_mm256_xor_si256(_mm256_loadu_si256(block + 1), flip), zero));
+		sum2 = _mm256_add_epi64(sum2, _mm256_sad_epu8(_mm256_xor_si256(_mm256_loadu_si256(block + 2), flip), zero));
+		sum3 = _mm256_add_epi64(sum3, _mm256_sad_epu8(_mm256_xor_si256(_mm256_loadu_si256(block + 3), flip), zero));
+	}
+
+	__m256i sum = _mm256_add_epi64(_mm256_add_epi64(sum0, sum1), _mm256_add_epi64(sum2, sum3));
+	uint64_t lanes[4];
+	_mm256_storeu_si256((__m256i *)lanes, sum);
+
+	return (long)(lanes[0] + lanes[1] + lanes[2] + lanes[3]) - Byte_Bias * (long)i +
+		   Sum_Scalar(numbers + i, count - i);
+}
+
+/* ----------------------------------------------------------- AVX-512BW --- */
+
+static int Avx512_Supported(void)
+{
+	return __builtin_cpu_supports("avx512bw");
+}
+
+TARGET_AVX512BW
+static long Sum_Avx512(const char *numbers, size_t count)
+{
+	const __m512i flip = _mm512_set1_epi8((char)0x80);
+	const __m512i zero = _mm512_setzero_si512();
+	__m512i sum0 = zero, sum1 = zero, sum2 = zero, sum3 = zero;
+
+	size_t i = 0;
+	for (; i + 256 <= count; i += 256)
+	{
+		const char *block = numbers + i;
+		sum0 = _mm512_add_epi64(sum0, _mm512_sad_epu8(_mm512_xor_si512(_mm512_loadu_si512(block + 0), flip), zero));
+		sum1 = _mm512_add_epi64(sum1, _mm512_sad_epu8(_mm512_xor_si512(_mm512_loadu_si512(block + 64), flip), zero));
+		sum2 = _mm512_add_epi64(sum2, _mm512_sad_epu8(_mm512_xor_si512(_mm512_loadu_si512(block + 128), flip), zero));
+		sum3 = _mm512_add_epi64(sum3, _mm512_sad_epu8(_mm512_xor_si512(_mm512_loadu_si512(block + 192), flip), zero));
+	}
+
+	__m512i sum = _mm512_add_epi64(_mm512_add_epi64(sum0, sum1), _mm512_add_epi64(sum2, sum3));
+
+	return (long)_mm512_reduce_add_epi64(sum) - Byte_Bias * (long)i + Sum_Scalar(numbers + i, count - i);
+}
+
+/* ------------------------------------------------------------ Dispatch --- */
+
+// Ordered from the narrowest to the widest, Sum_Kernel_Best takes the last supported one
+static const Sum_Kernel Kernels[] = {
+	{ "scalar", Sum_Scalar, Always_Supported },
+	{ "sse2",   Sum_Sse2,   Always_Supported },
+	{ "avx2",   Sum_Avx2,   Avx2_Supported },
+	{ "avx512", Sum_Avx512, Avx512_Supported },
+};
+
+static const int Number_Of_Kernels = sizeof(Kernels) / sizeof(Kernels[0]);
+
+const Sum_Kernel *Sum_Kernel_Find(const char *name)
+{
+	for (int i = 0; i < Number_Of_Kernels; i++)
+	{
+		if (strcmp(Kernels[i].name, name) == 0)
+		{
+			return &Kernels[i];
+		}
+	}
+	return NULL;
+}
+
+const Sum_Kernel *Sum_Kernel_Get(int index)
+{
+	return index >= 0 && index < Number_Of_Kernels ? &Kernels[index] : NULL;
+}
+
+const Sum_Kernel *Sum_Kernel_Best(void)
+{
+	const Sum_Kernel *best = &Kernels[0];
+	for (int i = 1; i < Number_Of_Kernels; i++)
+	{
+		if (Kernels[i].is_supported())
+		{
+			best = &Kernels[i];
+		}
+	}
+	return best;
+}
+
+void Sum_Kernel_Print_All(void)
+{
+	for (int i = 0; i < Number_Of_Kernels; i++)
+	{
+		printf("  %-12s%s\n", Kernels[i].name, Kernels[i].is_supported() ? "" : " (not supported by this CPU)");
+	}
+}
@@ -0,0 +1,41 @@
+#ifndef LAB2_SUM_KERNELS_H
+#define LAB2_SUM_KERNELS_H
+
+#include <stddef.h>
+
+/*
+ * Kernels that add up an array of chars (signed, as char is on x86).
+ *
+ * The vector kernels use the SAD instruction (psadbw), which adds the
+ * absolute differences of 8 unsigned bytes into one 64 bit lane; against
+ * zero that is simply the sum of the bytes, 16, 32 or 64 bytes per
+ * instruction. Signed bytes are first flipped to unsigned ones by
+ * toggling their top bit, which adds 128 to each of them, and the 128 per
+ * byte is subtracted from the total at the end. Every kernel keeps four
+ * independent accumulators so consecutive loads and SADs don't wait on
+ * each other, and all of them return exactly the same sum.
+ */
+
+// Returns the sum of numbers[0, count)
+typedef long (*Sum_Fn)(const char *numbers, size_t count);
+
+typedef struct Sum_Kernel {
+	const char *name;
+	Sum_Fn sum;
+	// Returns non zero when the running CPU can execute the kernel
+	int (*is_supported)(void);
+} Sum_Kernel;
+
+// Returns the kernel with the given name, or NULL if there is no such kernel
+const Sum_Kernel *Sum_Kernel_Find(const char *name);
+
+// Returns the kernel at index, or NULL once index is past the last kernel
+const Sum_Kernel *Sum_Kernel_Get(int index);
+
+// Returns the widest kernel supported by the running CPU
+const Sum_Kernel *Sum_Kernel_Best(void);
+
+// Writes the names of every kernel, marking the ones this CPU can't run
+void Sum_Kernel_Print_All(void);
+
+#endif //LAB2_SUM_KERNELS_H